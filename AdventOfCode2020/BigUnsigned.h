@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+
+// Arbitrary-precision unsigned integer with the few operations the solvers need: addition,
+// multiplication by a 64-bit value and remainder by a 64-bit value.
+class BigUnsigned
+{
+public:
+    BigUnsigned( uint64_t value = 0 )
+    {
+        for( ; value != 0; value >>= 32 )
+            m_limbs.push_back( static_cast<uint32_t>( value ) );
+    }
+
+    BigUnsigned& operator+=( const BigUnsigned& other )
+    {
+        if( m_limbs.size() < other.m_limbs.size() )
+            m_limbs.resize( other.m_limbs.size() );
+
+        uint64_t carry = 0;
+        for( size_t i = 0; i < m_limbs.size(); i++ ) {
+            carry += m_limbs[i];
+            if( i < other.m_limbs.size() )
+                carry += other.m_limbs[i];
+            m_limbs[i] = static_cast<uint32_t>( carry );
+            carry >>= 32;
+        }
+        if( carry != 0 )
+            m_limbs.push_back( static_cast<uint32_t>( carry ) );
+        return *this;
+    }
+
+    BigUnsigned& operator*=( uint64_t factor )
+    {
+        BigUnsigned result = mulLimb( static_cast<uint32_t>( factor ) );
+        if( factor >> 32 ) {
+            BigUnsigned high = mulLimb( static_cast<uint32_t>( factor >> 32 ) );
+            if( !high.m_limbs.empty() )
+                high.m_limbs.insert( high.m_limbs.begin(), 0 );
+            result += high;
+        }
+        return *this = std::move( result );
+    }
+
+    uint64_t operator%( uint64_t divisor ) const
+    {
+        auto addMod = [divisor] ( uint64_t a, uint64_t b ) { return a >= divisor - b ? a - ( divisor - b ) : a + b; };
+
+        uint64_t remainder = 0;
+        for( auto it = m_limbs.rbegin(); it != m_limbs.rend(); ++it ) {
+            if( divisor <= 0xFFFFFFFFull ) {
+                remainder = ( ( remainder << 32 ) | *it ) % divisor;
+                continue;
+            }
+            for( int bit = 0; bit < 32; bit++ ) {
+                remainder = addMod( remainder, remainder );
+            }
+            remainder = addMod( remainder, *it % divisor );
+        }
+        return remainder;
+    }
+
+    friend BigUnsigned operator+( BigUnsigned a, const BigUnsigned& b ) { return a += b; }
+    friend BigUnsigned operator*( BigUnsigned a, uint64_t b ) { return a *= b; }
+    bool operator==( const BigUnsigned& other ) const = default;
+
+    friend std::ostream& operator<<( std::ostream& stream, const BigUnsigned& value )
+    {
+        if( value.m_limbs.empty() )
+            return stream << '0';
+
+        std::vector<uint32_t> limbs = value.m_limbs;
+        std::vector<uint32_t> digitGroups;
+        while( !limbs.empty() ) {
+            uint64_t remainder = 0;
+            for( auto it = limbs.rbegin(); it != limbs.rend(); ++it ) {
+                uint64_t current = ( remainder << 32 ) | *it;
+                *it = static_cast<uint32_t>( current / 1000000000 );
+                remainder = current % 1000000000;
+            }
+            digitGroups.push_back( static_cast<uint32_t>( remainder ) );
+            while( !limbs.empty() && limbs.back() == 0 )
+                limbs.pop_back();
+        }
+
+        stream << digitGroups.back();
+        for( auto it = digitGroups.rbegin() + 1; it != digitGroups.rend(); ++it ) {
+            auto fill = stream.fill( '0' );
+            stream << std::setw( 9 ) << *it;
+            stream.fill( fill );
+        }
+        return stream;
+    }
+
+private:
+    BigUnsigned mulLimb( uint32_t factor ) const
+    {
+        BigUnsigned result;
+        if( factor == 0 )
+            return result;
+
+        uint64_t carry = 0;
+        for( auto& limb : m_limbs ) {
+            carry += uint64_t( limb ) * factor;
+            result.m_limbs.push_back( static_cast<uint32_t>( carry ) );
+            carry >>= 32;
+        }
+        if( carry != 0 )
+            result.m_limbs.push_back( static_cast<uint32_t>( carry ) );
+        return result;
+    }
+
+    std::vector<uint32_t> m_limbs;
+};
+
+#ifdef __SIZEOF_INT128__
+using UInt128 = unsigned __int128;
+
+inline std::ostream& operator<<( std::ostream& stream, UInt128 value )
+{
+    std::string digits;
+    do {
+        digits.push_back( static_cast<char>( '0' + value % 10 ) );
+        value /= 10;
+    } while( value != 0 );
+    return stream << std::string( digits.rbegin(), digits.rend() );
+}
+#endif
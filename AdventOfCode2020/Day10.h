@@ -7,70 +7,95 @@
 #include <numeric>
 #include <optional>
 #include <regex>
-#include <map>
 #include <span>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <bit>
+
+#include "BigUnsigned.h"
 
 std::vector<size_t> getData( const std::string& path )
 {
     std::vector<size_t> data;
     std::ifstream file( path );
-    while( !file.eof() ) {
-        data.push_back( 0 );
-        file >> data.back();
+    for( size_t value; file >> value; ) {
+        data.push_back( value );
     }
     return data;
 }
 
-int getChargerDif( std::vector<size_t> data )
+struct Joltages
 {
-    std::sort( data.begin(), data.end() );
-    std::vector<size_t> diffs( 4 );
-    size_t oldInput = 0;
-    for( auto& charger : data ) {
-        diffs[charger - oldInput]++;
-        oldInput = charger;
+    std::vector<uint64_t> presence;
+    size_t maxJoltage = 0;
+};
+
+Joltages getJoltages( const std::vector<size_t>& data )
+{
+    Joltages joltages;
+    joltages.maxJoltage = data.empty() ? 0 : *std::max_element( begin( data ), end( data ) );
+    joltages.presence.resize( joltages.maxJoltage / 64 + 1 );
+    joltages.presence[0] |= 1;
+    for( auto& joltage : data ) {
+        joltages.presence[joltage / 64] |= 1ull << ( joltage % 64 );
     }
-    diffs[3]++;
-    return diffs[1] * diffs[3];
+    return joltages;
 }
 
-size_t getNumPossibilitesRec( std::span<size_t> data, size_t idx, std::map<size_t, size_t>& checked )
+template<typename Func>
+void forEachJoltage( const Joltages& joltages, Func func )
 {
-    if( data.size() <= 2 )
-        return 1;
-
-    if( auto it = checked.find( idx ); it != checked.end() )
-        return it->second;
-
-    size_t possibilities = getNumPossibilitesRec( data.subspan( 1 ), idx + 1, checked );
-    if( data[2] - data[0] <= 3 )
-        possibilities += getNumPossibilitesRec( data.subspan( 2 ), idx + 2, checked );
-    if( data.size() > 3 && data[3] - data[0] <= 3 )
-        possibilities += getNumPossibilitesRec( data.subspan( 3 ), idx + 3, checked );
-
-    checked[idx] = possibilities;
+    for( size_t word = 0; word < joltages.presence.size(); word++ ) {
+        for( uint64_t bits = joltages.presence[word]; bits != 0; bits &= bits - 1 ) {
+            func( word * 64 + std::countr_zero( bits ) );
+        }
+    }
+}
 
-    return possibilities;
+size_t getChargerDif( const Joltages& joltages )
+{
+    std::vector<size_t> diffs( 4 );
+    size_t oldInput = 0;
+    forEachJoltage( joltages,
+        [&] ( size_t charger ) {
+            if( charger - oldInput >= diffs.size() )
+                diffs.resize( charger - oldInput + 1 );
+            diffs[charger - oldInput]++;
+            oldInput = charger;
+        } );
+    diffs[3]++;
+    return diffs[1] * diffs[3];
 }
 
-size_t getNumPossibilites( std::vector<size_t> data )
+template<typename CountType = size_t>
+CountType getNumPossibilites( const Joltages& joltages, size_t maxJoltGap = 3 )
 {
-    data.push_back( 0 );
-    std::sort( data.begin(), data.end() );
-    data.push_back( data.back() + 3 );
+    std::vector<CountType> counts( maxJoltGap );
+    std::vector<size_t> values( maxJoltGap );
+    size_t idx = 0;
 
-    std::map<size_t, size_t> checked;
+    auto addJoltage = [&] ( size_t joltage ) {
+        CountType count = idx == 0 ? 1 : 0;
+        for( size_t j = idx > maxJoltGap ? idx - maxJoltGap : 0; j < idx; j++ ) {
+            if( joltage - values[j % maxJoltGap] <= maxJoltGap )
+                count += counts[j % maxJoltGap];
+        }
+        counts[idx % maxJoltGap] = std::move( count );
+        values[idx % maxJoltGap] = joltage;
+        idx++;
+    };
+    forEachJoltage( joltages, addJoltage );
+    addJoltage( joltages.maxJoltage + maxJoltGap );
 
-    return getNumPossibilitesRec( data, 0, checked );
+    return counts[( idx - 1 ) % maxJoltGap];
 }
 
-
 void Day10()
 {
-    auto data = getData( "Day10Input.txt" );
-    
+    auto joltages = getJoltages( getData( "Day10Input.txt" ) );
 
     std::cout << "Day10:\n";
-    std::cout << "Part1: Jolt dif sum: " << getChargerDif( data ) << "\n";
-    std::cout << "Part2: Adapter Combinations: " << getNumPossibilites( data ) << "\n";
+    std::cout << "Part1: Jolt dif sum: " << getChargerDif( joltages ) << "\n";
+    std::cout << "Part2: Adapter Combinations: " << getNumPossibilites<BigUnsigned>( joltages ) << "\n";
 }
@@ -9,6 +9,17 @@
 #include <regex>
 #include <map>
 #include <span>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <bit>
+#include <array>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <barrier>
+
+#include "Grid.h"
 
 enum class Seat
 {
@@ -32,31 +43,7 @@ std::ostream& operator<<( std::ostream& stream, Seat seat )
 }
 
 template<typename T>
-class Matrix
-{
-public:
-    Matrix( int numCols, int numRows, std::vector<T> data ) : m_data( std::move( data ) ), m_numCols( numCols ), m_numRows( numRows ) {}
-    T& at( int col, int row ) { return m_data[col + row * m_numCols]; }
-    const T& at( int col, int row ) const { return m_data[col + row * m_numCols]; }
-    std::optional<T> optAt( int col, int row ) const { if( col < 0 || col >= m_numCols || row < 0 || row >= m_numRows ) return {}; return at( col, row ); }
-    int getNumRows() const { return m_numRows; }
-    int getNumCols() const { return m_numCols; }
-    void print()
-    {
-        for( size_t row = 0; row < m_numRows; row++ ) {
-            for( size_t col = 0; col < m_numCols; col++ ) {
-                std::cout << at( col, row );
-            }
-            std::cout << "\n";
-        }
-    }
-    bool isInside( int col, int row ) const { return col >= 0 && col < m_numCols&& row >= 0 && row < m_numRows; }
-
-private:
-    std::vector<T> m_data;
-    int m_numCols;
-    int m_numRows;
-};
+using Matrix = Grid<T>;
 
 Seat charToSeat( char c )
 {
@@ -98,16 +85,16 @@ int getNumSurrounding( const Matrix<Seat>& seats, int column, int row )
         for( auto& colOffs : { -1,0,1 } ) {
             if( rowOffs == 0 && colOffs == 0 )
                 continue;
-            numSeatsTaken += seats.optAt( column + colOffs, row + rowOffs ).value_or( Seat::None ) == Seat::Taken;
+            numSeatsTaken += seats.at( column + colOffs, row + rowOffs ) == Seat::Taken;
         }
     }
     return numSeatsTaken;
 }
 
-bool applyStep( Matrix<Seat>& targetSeats, const Matrix<Seat>& srcSeats )
+bool applyStep( Matrix<Seat>& targetSeats, const Matrix<Seat>& srcSeats, int rowBegin, int rowEnd )
 {
     bool changed = false;
-    for( int row = 0; row < srcSeats.getNumRows(); row++ ) {
+    for( int row = rowBegin; row < rowEnd; row++ ) {
         for( int col = 0; col < srcSeats.getNumCols(); col++ ) {
             int numNeighbors = getNumSurrounding( srcSeats, col, row );
             if( numNeighbors == 0 && srcSeats.at( col, row ) == Seat::Free ) {
@@ -125,6 +112,11 @@ bool applyStep( Matrix<Seat>& targetSeats, const Matrix<Seat>& srcSeats )
     return changed;
 }
 
+bool applyStep( Matrix<Seat>& targetSeats, const Matrix<Seat>& srcSeats )
+{
+    return applyStep( targetSeats, srcSeats, 0, srcSeats.getNumRows() );
+}
+
 int numSeatsTaken( const Matrix<Seat>& seatData )
 {
     int seatsTaken = 0;
@@ -147,6 +139,136 @@ int getFinalNumSeatsTaken( Matrix<Seat> seatData )
     return numSeatsTaken( seatData );
 }
 
+// Seat grid stored as bitplanes with one cell of empty padding on every side, so the 8 neighbors
+// of 64 cells can be gathered with shifts and summed with bit-sliced adders.
+class SeatPlanes
+{
+public:
+    explicit SeatPlanes( const Matrix<Seat>& seats );
+    bool step();
+    int getNumTaken() const;
+    Matrix<Seat> toMatrix() const;
+
+private:
+    size_t getIdx( int col, int row ) const { return ( row + 1 ) * m_rowWords + ( col + 1 ) / 64; }
+    uint64_t getBit( int col ) const { return 1ull << ( ( col + 1 ) % 64 ); }
+
+    int m_numCols;
+    int m_numRows;
+    size_t m_rowWords;
+    std::vector<uint64_t> m_seats;
+    std::vector<uint64_t> m_floor;
+    std::vector<uint64_t> m_taken;
+    std::vector<uint64_t> m_nextTaken;
+};
+
+SeatPlanes::SeatPlanes( const Matrix<Seat>& seats )
+    : m_numCols( seats.getNumCols() ), m_numRows( seats.getNumRows() ), m_rowWords( ( seats.getNumCols() + 2 + 63 ) / 64 )
+{
+    size_t size = ( m_numRows + 2 ) * m_rowWords;
+    m_seats.resize( size );
+    m_floor.resize( size );
+    m_taken.resize( size );
+    m_nextTaken.resize( size );
+    for( int row = 0; row < m_numRows; row++ ) {
+        for( int col = 0; col < m_numCols; col++ ) {
+            auto seat = seats.at( col, row );
+            auto& plane = seat == Seat::None ? m_floor : m_seats;
+            plane[getIdx( col, row )] |= getBit( col );
+            if( seat == Seat::Taken )
+                m_taken[getIdx( col, row )] |= getBit( col );
+        }
+    }
+}
+
+namespace
+{
+    inline void fullAdd( uint64_t a, uint64_t b, uint64_t c, uint64_t& sum, uint64_t& carry )
+    {
+        uint64_t ab = a ^ b;
+        sum = ab ^ c;
+        carry = ( a & b ) | ( ab & c );
+    }
+
+    inline uint64_t shiftedLeft( const uint64_t* row, size_t word )
+    {
+        return ( row[word] << 1 ) | ( word > 0 ? row[word - 1] >> 63 : 0 );
+    }
+
+    inline uint64_t shiftedRight( const uint64_t* row, size_t word, size_t rowWords )
+    {
+        return ( row[word] >> 1 ) | ( word + 1 < rowWords ? row[word + 1] << 63 : 0 );
+    }
+}
+
+bool SeatPlanes::step()
+{
+    uint64_t changed = 0;
+    for( int row = 0; row < m_numRows; row++ ) {
+        const uint64_t* above = &m_taken[row * m_rowWords];
+        const uint64_t* center = above + m_rowWords;
+        const uint64_t* below = center + m_rowWords;
+        size_t rowStart = ( row + 1 ) * m_rowWords;
+        for( size_t word = 0; word < m_rowWords; word++ ) {
+            uint64_t ones1, twos1, ones2, twos2, ones3, twos3, ones, twos4;
+            fullAdd( shiftedLeft( above, word ), above[word], shiftedRight( above, word, m_rowWords ), ones1, twos1 );
+            fullAdd( shiftedLeft( below, word ), below[word], shiftedRight( below, word, m_rowWords ), ones2, twos2 );
+            uint64_t left = shiftedLeft( center, word );
+            uint64_t right = shiftedRight( center, word, m_rowWords );
+            ones3 = left ^ right;
+            twos3 = left & right;
+            fullAdd( ones1, ones2, ones3, ones, twos4 );
+
+            uint64_t twosSum, fours1;
+            fullAdd( twos1, twos2, twos3, twosSum, fours1 );
+            uint64_t twos = twosSum ^ twos4;
+            uint64_t fours2 = twosSum & twos4;
+            uint64_t atLeastFour = fours1 | fours2;
+            uint64_t none = ~( ones | twos | atLeastFour );
+
+            uint64_t taken = center[word];
+            uint64_t nextTaken = m_seats[rowStart + word] & ( ( ~taken & none ) | ( taken & ~atLeastFour ) );
+            m_nextTaken[rowStart + word] = nextTaken;
+            changed |= nextTaken ^ taken;
+        }
+    }
+    std::swap( m_taken, m_nextTaken );
+    return changed != 0;
+}
+
+int SeatPlanes::getNumTaken() const
+{
+    int numTaken = 0;
+    for( auto& word : m_taken ) {
+        numTaken += std::popcount( word );
+    }
+    return numTaken;
+}
+
+Matrix<Seat> SeatPlanes::toMatrix() const
+{
+    std::vector<Seat> data;
+    for( int row = 0; row < m_numRows; row++ ) {
+        for( int col = 0; col < m_numCols; col++ ) {
+            if( m_taken[getIdx( col, row )] & getBit( col ) )
+                data.push_back( Seat::Taken );
+            else if( m_seats[getIdx( col, row )] & getBit( col ) )
+                data.push_back( Seat::Free );
+            else
+                data.push_back( Seat::None );
+        }
+    }
+    return { m_numCols, m_numRows, std::move( data ) };
+}
+
+int getFinalNumSeatsTakenBitwise( const Matrix<Seat>& seatData )
+{
+    SeatPlanes planes( seatData );
+    while( planes.step() );
+
+    return planes.getNumTaken();
+}
+
 struct Vec2
 {
     int x, y;
@@ -187,10 +309,10 @@ int getNumSeenSeats( const Matrix<Seat>& seatData, Vec2 pos )
     return numSeenSeats;
 }
 
-bool applyStepDir( Matrix<Seat>& targetSeats, const Matrix<Seat>& srcSeats )
+bool applyStepDir( Matrix<Seat>& targetSeats, const Matrix<Seat>& srcSeats, int rowBegin, int rowEnd )
 {
     bool changed = false;
-    for( int row = 0; row < srcSeats.getNumRows(); row++ ) {
+    for( int row = rowBegin; row < rowEnd; row++ ) {
         for( int col = 0; col < srcSeats.getNumCols(); col++ ) {
             if( srcSeats.at( col, row ) == Seat::None )
                 continue;
@@ -211,6 +333,11 @@ bool applyStepDir( Matrix<Seat>& targetSeats, const Matrix<Seat>& srcSeats )
     return changed;
 }
 
+bool applyStepDir( Matrix<Seat>& targetSeats, const Matrix<Seat>& srcSeats )
+{
+    return applyStepDir( targetSeats, srcSeats, 0, srcSeats.getNumRows() );
+}
+
 int getFinalNumSeatsTakenDir( Matrix<Seat> seatData )
 {
     auto tmpSeats = seatData;
@@ -221,11 +348,218 @@ int getFinalNumSeatsTakenDir( Matrix<Seat> seatData )
     return numSeatsTaken( seatData );
 }
 
+// Splits the rows into one band per thread. Every band only writes its own rows of the target buffer
+// and reads the shared source buffer, and all threads meet at a barrier that swaps the buffers.
+int getFinalNumSeatsTakenParallel( Matrix<Seat> seatData, bool lineOfSight, size_t numThreads = std::thread::hardware_concurrency() )
+{
+    numThreads = std::clamp<size_t>( numThreads, 1, std::max( seatData.getNumRows(), 1 ) );
+
+    auto tmpSeats = seatData;
+    Matrix<Seat>* srcSeats = &seatData;
+    Matrix<Seat>* targetSeats = &tmpSeats;
+    std::atomic<bool> changed = false;
+    bool running = true;
+    std::barrier barrier( numThreads,
+        [&] () noexcept {
+            running = changed.exchange( false );
+            std::swap( srcSeats, targetSeats );
+        } );
+
+    auto worker = [&] ( size_t band ) {
+        int rowBegin = int( seatData.getNumRows() * band / numThreads );
+        int rowEnd = int( seatData.getNumRows() * ( band + 1 ) / numThreads );
+        while( running ) {
+            bool bandChanged = lineOfSight ? applyStepDir( *targetSeats, *srcSeats, rowBegin, rowEnd )
+                : applyStep( *targetSeats, *srcSeats, rowBegin, rowEnd );
+            if( bandChanged )
+                changed = true;
+            barrier.arrive_and_wait();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for( size_t band = 1; band < numThreads; band++ ) {
+        threads.emplace_back( worker, band );
+    }
+    worker( 0 );
+    for( auto& thread : threads ) {
+        thread.join();
+    }
+
+    return numSeatsTaken( *srcSeats );
+}
+
+enum class Visibility
+{
+    Adjacent,
+    LineOfSight
+};
+
+// Seats with the indices of the up-to-8 seats they consider, resolved once since the floor never changes.
+// A step then only gathers the taken flags of those seats.
+class SeatGraph
+{
+public:
+    SeatGraph( const Matrix<Seat>& seats, Visibility visibility );
+    bool step( int maxTaken );
+    bool stepActive( int maxTaken );
+    int getNumTaken() const;
+    Matrix<Seat> toMatrix() const;
+
+private:
+    int m_numCols;
+    int m_numRows;
+    std::vector<uint32_t> m_cells;
+    std::vector<uint32_t> m_neighborStart;
+    std::vector<uint32_t> m_neighbors;
+    std::vector<uint8_t> m_taken;
+    std::vector<uint8_t> m_nextTaken;
+    std::vector<uint32_t> m_active;
+    std::vector<uint8_t> m_isActive;
+};
+
+SeatGraph::SeatGraph( const Matrix<Seat>& seats, Visibility visibility )
+    : m_numCols( seats.getNumCols() ), m_numRows( seats.getNumRows() )
+{
+    constexpr uint32_t noSeat = std::numeric_limits<uint32_t>::max();
+    size_t numCells = size_t( m_numCols ) * m_numRows;
+
+    std::vector<uint32_t> seatIdx( numCells, noSeat );
+    for( int row = 0; row < m_numRows; row++ ) {
+        for( int col = 0; col < m_numCols; col++ ) {
+            if( seats.at( col, row ) == Seat::None )
+                continue;
+            seatIdx[col + row * size_t( m_numCols )] = uint32_t( m_cells.size() );
+            m_cells.push_back( uint32_t( col + row * m_numCols ) );
+            m_taken.push_back( seats.at( col, row ) == Seat::Taken );
+        }
+    }
+
+    std::vector<std::array<uint32_t, 8>> visible( m_cells.size() );
+    std::vector<uint32_t> reach( numCells );
+    int dirIdx = 0;
+    for( auto& y : { -1,0,1 } ) {
+        for( auto& x : { -1,0,1 } ) {
+            if( x == 0 && y == 0 )
+                continue;
+
+            // reach holds the first seat found when looking from a cell in direction (x, y), including the
+            // cell itself. Visiting cells so that cell + dir comes first resolves every cell in one sweep.
+            for( int i = 0; i < m_numRows; i++ ) {
+                int row = y > 0 ? m_numRows - 1 - i : i;
+                for( int j = 0; j < m_numCols; j++ ) {
+                    int col = x > 0 ? m_numCols - 1 - j : j;
+                    size_t cell = col + row * size_t( m_numCols );
+                    uint32_t firstSeen = noSeat;
+                    if( seats.isInside( col + x, row + y ) ) {
+                        size_t nextCell = ( col + x ) + ( row + y ) * size_t( m_numCols );
+                        firstSeen = visibility == Visibility::LineOfSight ? reach[nextCell] : seatIdx[nextCell];
+                    }
+                    if( seatIdx[cell] != noSeat )
+                        visible[seatIdx[cell]][dirIdx] = firstSeen;
+                    reach[cell] = seatIdx[cell] != noSeat ? seatIdx[cell] : firstSeen;
+                }
+            }
+            dirIdx++;
+        }
+    }
+
+    m_neighborStart.push_back( 0 );
+    for( auto& seatVisible : visible ) {
+        std::copy_if( begin( seatVisible ), end( seatVisible ), std::back_inserter( m_neighbors ),
+            [] ( uint32_t seat ) { return seat != noSeat; } );
+        m_neighborStart.push_back( uint32_t( m_neighbors.size() ) );
+    }
+    m_nextTaken.resize( m_taken.size() );
+    m_active.resize( m_taken.size() );
+    std::iota( begin( m_active ), end( m_active ), 0 );
+    m_isActive.resize( m_taken.size(), 1 );
+}
+
+bool SeatGraph::step( int maxTaken )
+{
+    bool changed = false;
+    for( size_t seat = 0; seat < m_taken.size(); seat++ ) {
+        int numSeenSeats = 0;
+        for( uint32_t i = m_neighborStart[seat]; i < m_neighborStart[seat + 1]; i++ ) {
+            numSeenSeats += m_taken[m_neighbors[i]];
+        }
+        bool taken = m_taken[seat] ? numSeenSeats < maxTaken : numSeenSeats == 0;
+        changed |= taken != bool( m_taken[seat] );
+        m_nextTaken[seat] = taken;
+    }
+    std::swap( m_taken, m_nextTaken );
+    return changed;
+}
+
+// Only re-evaluates the seats whose neighborhood changed in the previous call, so the cost of a
+// generation follows the number of flipped seats instead of the number of seats.
+bool SeatGraph::stepActive( int maxTaken )
+{
+    std::vector<uint32_t> flipped;
+    for( auto& seat : m_active ) {
+        m_isActive[seat] = 0;
+        int numSeenSeats = 0;
+        for( uint32_t i = m_neighborStart[seat]; i < m_neighborStart[seat + 1]; i++ ) {
+            numSeenSeats += m_taken[m_neighbors[i]];
+        }
+        bool taken = m_taken[seat] ? numSeenSeats < maxTaken : numSeenSeats == 0;
+        if( taken != bool( m_taken[seat] ) )
+            flipped.push_back( seat );
+    }
+
+    m_active.clear();
+    auto activate = [this] ( uint32_t seat ) {
+        if( !m_isActive[seat] ) {
+            m_isActive[seat] = 1;
+            m_active.push_back( seat );
+        }
+    };
+    for( auto& seat : flipped ) {
+        m_taken[seat] ^= 1;
+        activate( seat );
+        for( uint32_t i = m_neighborStart[seat]; i < m_neighborStart[seat + 1]; i++ ) {
+            activate( m_neighbors[i] );
+        }
+    }
+    return !flipped.empty();
+}
+
+int SeatGraph::getNumTaken() const
+{
+    return int( std::count( begin( m_taken ), end( m_taken ), 1 ) );
+}
+
+Matrix<Seat> SeatGraph::toMatrix() const
+{
+    std::vector<Seat> data( size_t( m_numCols ) * m_numRows, Seat::None );
+    for( size_t seat = 0; seat < m_cells.size(); seat++ ) {
+        data[m_cells[seat]] = m_taken[seat] ? Seat::Taken : Seat::Free;
+    }
+    return { m_numCols, m_numRows, std::move( data ) };
+}
+
+int getFinalNumSeatsTakenGraph( const Matrix<Seat>& seatData, Visibility visibility, int maxTaken )
+{
+    SeatGraph graph( seatData, visibility );
+    while( graph.step( maxTaken ) );
+
+    return graph.getNumTaken();
+}
+
+int getFinalNumSeatsTakenIncremental( const Matrix<Seat>& seatData, Visibility visibility, int maxTaken )
+{
+    SeatGraph graph( seatData, visibility );
+    while( graph.stepActive( maxTaken ) );
+
+    return graph.getNumTaken();
+}
+
 void Day11()
 {
     auto data = getData( "Day11Input.txt" );
 
     std::cout << "Day 11:\n";
-    std::cout << "Part1: final number of seats taken: " << getFinalNumSeatsTaken( data ) << "\n";
-    std::cout << "Part2: final number of seats taken: " << getFinalNumSeatsTakenDir( data ) << "\n";
+    std::cout << "Part1: final number of seats taken: " << getFinalNumSeatsTakenBitwise( data ) << "\n";
+    std::cout << "Part2: final number of seats taken: " << getFinalNumSeatsTakenIncremental( data, Visibility::LineOfSight, 5 ) << "\n";
 }
@@ -8,6 +8,13 @@
 #include <optional>
 #include <regex>
 #include <map>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <limits>
+#include <iterator>
+#include <bit>
 
 enum class InstructionType
 {
@@ -73,22 +80,124 @@ InstructionType getInstructionType( char c )
     throw std::runtime_error( "invalid instruction" );
 }
 
-Instruction parseInstruction( const std::string& line )
+// Instructions as a packed structure of arrays: one opcode byte (the InstructionType) and one value per
+// instruction.
+struct InstructionStream
 {
-    static std::regex regex( R"((\w)(\d+))" );
-    std::smatch match;
-    if( !std::regex_match( line, match, regex ) )
-        throw std::runtime_error( "invalid instrucion" );
+    std::vector<uint8_t> opcodes;
+    std::vector<int32_t> values;
 
-    return { getInstructionType( match[1].str()[0] ), std::stoi( match[2] ) };
+    size_t size() const { return opcodes.size(); }
+    Instruction operator[]( size_t idx ) const { return { InstructionType( opcodes[idx] ), values[idx] }; }
+};
+
+InstructionStream decodeInstructions( std::string_view text )
+{
+    constexpr std::string_view opcodeChars = "NSEWLRF";
+
+    InstructionStream stream;
+    stream.opcodes.reserve( text.size() / 3 );
+    stream.values.reserve( text.size() / 3 );
+
+    auto throwError = [] ( size_t line, size_t column, const std::string& message ) {
+        throw std::runtime_error( "invalid instruction at line " + std::to_string( line ) + ", column " + std::to_string( column ) + ": " + message );
+    };
+
+    size_t line = 1;
+    for( size_t pos = 0; pos < text.size(); line++ ) {
+        size_t lineStart = pos;
+        if( text[pos] == '\n' || text[pos] == '\r' ) {
+            pos += text[pos] == '\r' && pos + 1 < text.size() && text[pos + 1] == '\n' ? 2 : 1;
+            continue;
+        }
+
+        auto opcode = opcodeChars.find( text[pos] );
+        if( opcode == std::string_view::npos )
+            throwError( line, 1, "unknown opcode" );
+        pos++;
+
+        if( pos == text.size() || text[pos] < '0' || text[pos] > '9' )
+            throwError( line, pos - lineStart + 1, "expected value" );
+        int64_t value = 0;
+        for( ; pos < text.size() && text[pos] >= '0' && text[pos] <= '9'; pos++ ) {
+            value = value * 10 + ( text[pos] - '0' );
+            if( value > std::numeric_limits<int32_t>::max() )
+                throwError( line, pos - lineStart + 1, "value out of range" );
+        }
+
+        if( pos < text.size() && text[pos] == '\r' )
+            pos++;
+        if( pos < text.size() && text[pos] != '\n' )
+            throwError( line, pos - lineStart + 1, "unexpected character" );
+        pos++;
+
+        stream.opcodes.push_back( uint8_t( opcode ) );
+        stream.values.push_back( int32_t( value ) );
+    }
+    return stream;
+}
+
+std::string readFile( const std::string& path )
+{
+    std::ifstream file( path, std::ios::binary );
+    if( !file )
+        throw std::runtime_error( "could not open " + path );
+    return { std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() };
+}
+
+InstructionStream decodeInstructionFile( const std::string& path )
+{
+    return decodeInstructions( readFile( path ) );
+}
+
+namespace
+{
+    constexpr char instructionStreamMagic[4] = { 'D','1','2','I' };
+}
+
+// Binary layout: magic, uint64 count, count opcode bytes, count int32 values (native byte order).
+void writeInstructionStream( const InstructionStream& stream, const std::string& path )
+{
+    std::ofstream file( path, std::ios::binary );
+    uint64_t count = stream.size();
+    file.write( instructionStreamMagic, sizeof( instructionStreamMagic ) );
+    file.write( reinterpret_cast<const char*>( &count ), sizeof( count ) );
+    file.write( reinterpret_cast<const char*>( stream.opcodes.data() ), count );
+    file.write( reinterpret_cast<const char*>( stream.values.data() ), count * sizeof( int32_t ) );
+    if( !file )
+        throw std::runtime_error( "could not write " + path );
+}
+
+InstructionStream readInstructionStream( const std::string& path )
+{
+    std::ifstream file( path, std::ios::binary );
+    char magic[4] = {};
+    uint64_t count = 0;
+    file.read( magic, sizeof( magic ) );
+    file.read( reinterpret_cast<char*>( &count ), sizeof( count ) );
+    if( !file || !std::equal( std::begin( magic ), std::end( magic ), instructionStreamMagic ) )
+        throw std::runtime_error( "invalid instruction stream " + path );
+
+    InstructionStream stream;
+    stream.opcodes.resize( count );
+    stream.values.resize( count );
+    file.read( reinterpret_cast<char*>( stream.opcodes.data() ), count );
+    file.read( reinterpret_cast<char*>( stream.values.data() ), count * sizeof( int32_t ) );
+    if( !file )
+        throw std::runtime_error( "truncated instruction stream " + path );
+    for( auto& opcode : stream.opcodes ) {
+        if( opcode > uint8_t( InstructionType::MoveForward ) )
+            throw std::runtime_error( "invalid opcode in instruction stream " + path );
+    }
+    return stream;
 }
 
 std::vector<Instruction> parseInstructions( const std::string& path )
 {
-    std::vector<Instruction> instructions;
-    std::ifstream file( path );
-    for( std::string line; std::getline( file, line ); ) {
-        instructions.push_back( parseInstruction( line ) );
+    auto stream = decodeInstructionFile( path );
+    std::vector<Instruction> instructions( stream.size() );
+    for( size_t i = 0; i < stream.size(); i++ ) {
+        instructions[i] = stream[i];
     }
     return instructions;
 }
@@ -278,6 +387,339 @@ int getDistanceAfterWaypointInstructions( const std::vector<Instruction>& instru
     return std::abs( ship.position.x ) + std::abs( ship.position.y );
 }
 
+template<typename ShipType>
+int64_t getDistance( const ShipType& ship )
+{
+    return std::abs( int64_t( ship.position.x ) ) + std::abs( int64_t( ship.position.y ) );
+}
+
+// Keeps a snapshot of the ship every checkpointSpacing instructions plus a sparse table over the
+// maximum distance of each checkpoint block. State queries replay from the nearest checkpoint, range
+// maximum queries replay only the two partial blocks at the ends. Memory is about
+// n / checkpointSpacing * ( sizeof( ShipType ) + log2( n / checkpointSpacing ) * 8 ) bytes.
+template<typename ShipType>
+class RouteTimeline
+{
+public:
+    RouteTimeline( std::vector<Instruction> instructions, size_t checkpointSpacing = 1024 );
+    size_t getNumSteps() const { return m_instructions.size(); }
+    ShipType getShipAt( size_t step ) const;
+    int64_t getMaxDistance( size_t firstStep, size_t lastStep ) const;
+    int64_t getMaxDistance() const { return getMaxDistance( 0, getNumSteps() ); }
+    size_t getMemoryUsage() const;
+
+private:
+    int64_t getMaxDistanceReplayed( size_t firstStep, size_t lastStep ) const;
+    int64_t getMaxDistanceOfBlocks( size_t firstBlock, size_t lastBlock ) const;
+
+    std::vector<Instruction> m_instructions;
+    size_t m_checkpointSpacing;
+    std::vector<ShipType> m_checkpoints;
+    std::vector<std::vector<int64_t>> m_blockMaxima;
+};
+
+template<typename ShipType>
+RouteTimeline<ShipType>::RouteTimeline( std::vector<Instruction> instructions, size_t checkpointSpacing )
+    : m_instructions( std::move( instructions ) ), m_checkpointSpacing( std::max<size_t>( checkpointSpacing, 1 ) )
+{
+    size_t numBlocks = m_instructions.size() / m_checkpointSpacing + 1;
+    m_checkpoints.reserve( numBlocks );
+    m_blockMaxima.emplace_back( numBlocks, 0 );
+
+    ShipType ship;
+    for( size_t step = 0; step <= m_instructions.size(); step++ ) {
+        if( step % m_checkpointSpacing == 0 )
+            m_checkpoints.push_back( ship );
+        auto& blockMax = m_blockMaxima[0][step / m_checkpointSpacing];
+        blockMax = std::max( blockMax, getDistance( ship ) );
+        if( step < m_instructions.size() )
+            executeInstruction( ship, m_instructions[step] );
+    }
+
+    for( size_t width = 2; width <= numBlocks; width *= 2 ) {
+        auto& previous = m_blockMaxima.back();
+        std::vector<int64_t> level( numBlocks - width + 1 );
+        for( size_t i = 0; i < level.size(); i++ ) {
+            level[i] = std::max( previous[i], previous[i + width / 2] );
+        }
+        m_blockMaxima.push_back( std::move( level ) );
+    }
+}
+
+template<typename ShipType>
+ShipType RouteTimeline<ShipType>::getShipAt( size_t step ) const
+{
+    step = std::min( step, m_instructions.size() );
+    ShipType ship = m_checkpoints[step / m_checkpointSpacing];
+    for( size_t i = step / m_checkpointSpacing * m_checkpointSpacing; i < step; i++ ) {
+        executeInstruction( ship, m_instructions[i] );
+    }
+    return ship;
+}
+
+template<typename ShipType>
+int64_t RouteTimeline<ShipType>::getMaxDistanceReplayed( size_t firstStep, size_t lastStep ) const
+{
+    ShipType ship = getShipAt( firstStep );
+    int64_t maxDistance = getDistance( ship );
+    for( size_t i = firstStep; i < lastStep; i++ ) {
+        executeInstruction( ship, m_instructions[i] );
+        maxDistance = std::max( maxDistance, getDistance( ship ) );
+    }
+    return maxDistance;
+}
+
+template<typename ShipType>
+int64_t RouteTimeline<ShipType>::getMaxDistanceOfBlocks( size_t firstBlock, size_t lastBlock ) const
+{
+    size_t level = std::bit_width( lastBlock - firstBlock + 1 ) - 1;
+    return std::max( m_blockMaxima[level][firstBlock], m_blockMaxima[level][lastBlock + 1 - ( size_t( 1 ) << level )] );
+}
+
+// Maximum distance over the states after firstStep..lastStep instructions, both inclusive.
+template<typename ShipType>
+int64_t RouteTimeline<ShipType>::getMaxDistance( size_t firstStep, size_t lastStep ) const
+{
+    lastStep = std::min( lastStep, m_instructions.size() );
+    if( firstStep > lastStep )
+        throw std::runtime_error( "invalid step range" );
+
+    size_t firstFullBlock = ( firstStep + m_checkpointSpacing - 1 ) / m_checkpointSpacing;
+    size_t endFullBlocks = ( lastStep + 1 ) / m_checkpointSpacing;
+    if( firstFullBlock >= endFullBlocks )
+        return getMaxDistanceReplayed( firstStep, lastStep );
+
+    int64_t maxDistance = getMaxDistanceOfBlocks( firstFullBlock, endFullBlocks - 1 );
+    if( firstStep < firstFullBlock * m_checkpointSpacing )
+        maxDistance = std::max( maxDistance, getMaxDistanceReplayed( firstStep, firstFullBlock * m_checkpointSpacing - 1 ) );
+    if( endFullBlocks * m_checkpointSpacing <= lastStep )
+        maxDistance = std::max( maxDistance, getMaxDistanceReplayed( endFullBlocks * m_checkpointSpacing, lastStep ) );
+    return maxDistance;
+}
+
+template<typename ShipType>
+size_t RouteTimeline<ShipType>::getMemoryUsage() const
+{
+    size_t memory = m_checkpoints.capacity() * sizeof( ShipType );
+    for( auto& level : m_blockMaxima ) {
+        memory += level.capacity() * sizeof( int64_t );
+    }
+    return memory;
+}
+
+enum class NavigationMode
+{
+    Heading,
+    Waypoint
+};
+
+struct Mat2
+{
+    int64_t xx = 1;
+    int64_t xy = 0;
+    int64_t yx = 0;
+    int64_t yy = 1;
+};
+
+struct Offset
+{
+    int64_t x = 0;
+    int64_t y = 0;
+};
+
+Mat2 operator*( const Mat2& a, const Mat2& b )
+{
+    return { a.xx * b.xx + a.xy * b.yx, a.xx * b.xy + a.xy * b.yy, a.yx * b.xx + a.yy * b.yx, a.yx * b.xy + a.yy * b.yy };
+}
+
+Mat2 operator+( const Mat2& a, const Mat2& b )
+{
+    return { a.xx + b.xx, a.xy + b.xy, a.yx + b.yx, a.yy + b.yy };
+}
+
+Offset operator*( const Mat2& m, const Offset& v )
+{
+    return { m.xx * v.x + m.xy * v.y, m.yx * v.x + m.yy * v.y };
+}
+
+Offset operator+( const Offset& a, const Offset& b )
+{
+    return { a.x + b.x, a.y + b.y };
+}
+
+// Every instruction maps (position, direction) affinely, where direction is the heading as a unit vector
+// or the waypoint:
+//   direction' = rotation * direction + directionOffset
+//   position'  = position + forward * direction + positionOffset
+// The same form is closed under composition, so a whole route collapses into one NavigationTransform.
+struct NavigationTransform
+{
+    Mat2 rotation;
+    Offset directionOffset;
+    Mat2 forward{ 0,0,0,0 };
+    Offset positionOffset;
+};
+
+NavigationTransform compose( const NavigationTransform& first, const NavigationTransform& second )
+{
+    return {
+        second.rotation * first.rotation,
+        second.rotation * first.directionOffset + second.directionOffset,
+        first.forward + second.forward * first.rotation,
+        first.positionOffset + second.forward * first.directionOffset + second.positionOffset };
+}
+
+Mat2 getRotationLeft( int value )
+{
+    Mat2 rotation;
+    for( ; value > 0; value -= 90 ) {
+        rotation = Mat2{ 0,-1,1,0 } * rotation;
+    }
+    return rotation;
+}
+
+NavigationTransform getTransform( const Instruction& instruction, NavigationMode mode )
+{
+    NavigationTransform transform;
+    Offset& moveOffset = mode == NavigationMode::Heading ? transform.positionOffset : transform.directionOffset;
+    switch( instruction.instruction ) {
+    case InstructionType::MoveNorth:
+        moveOffset.y = instruction.value;
+        return transform;
+    case InstructionType::MoveSouth:
+        moveOffset.y = -instruction.value;
+        return transform;
+    case InstructionType::MoveEast:
+        moveOffset.x = instruction.value;
+        return transform;
+    case InstructionType::MoveWest:
+        moveOffset.x = -instruction.value;
+        return transform;
+    case InstructionType::RotateLeft:
+        transform.rotation = getRotationLeft( instruction.value );
+        return transform;
+    case InstructionType::RotateRight:
+        transform.rotation = getRotationLeft( instruction.value );
+        std::swap( transform.rotation.xy, transform.rotation.yx );
+        return transform;
+    case InstructionType::MoveForward:
+        transform.forward = { instruction.value, 0, 0, instruction.value };
+        return transform;
+    }
+    throw std::runtime_error( "invalid instruction" );
+}
+
+NavigationTransform getRouteTransform( const std::vector<Instruction>& instructions, NavigationMode mode )
+{
+    NavigationTransform transform;
+    for( auto& instruction : instructions ) {
+        transform = compose( transform, getTransform( instruction, mode ) );
+    }
+    return transform;
+}
+
+NavigationTransform getRouteTransform( const InstructionStream& stream, NavigationMode mode )
+{
+    NavigationTransform transform;
+    for( size_t i = 0; i < stream.size(); i++ ) {
+        transform = compose( transform, getTransform( stream[i], mode ) );
+    }
+    return transform;
+}
+
+// prefixes[k] is the transform of the first k instructions. Each thread scans its own chunk, then the
+// chunk totals are combined and every chunk is shifted by the transform of everything in front of it.
+std::vector<NavigationTransform> getPrefixTransforms( const std::vector<Instruction>& instructions, NavigationMode mode,
+    size_t numThreads = std::thread::hardware_concurrency() )
+{
+    std::vector<NavigationTransform> prefixes( instructions.size() + 1 );
+    numThreads = std::clamp<size_t>( numThreads, 1, std::max<size_t>( instructions.size(), 1 ) );
+    auto getChunkBegin = [&] ( size_t chunk ) { return instructions.size() * chunk / numThreads; };
+
+    auto runOnChunks = [&] ( auto func ) {
+        std::vector<std::thread> threads;
+        for( size_t chunk = 1; chunk < numThreads; chunk++ ) {
+            threads.emplace_back( func, chunk );
+        }
+        func( 0 );
+        for( auto& thread : threads ) {
+            thread.join();
+        }
+    };
+
+    runOnChunks( [&] ( size_t chunk ) {
+        NavigationTransform transform;
+        for( size_t i = getChunkBegin( chunk ); i < getChunkBegin( chunk + 1 ); i++ ) {
+            transform = compose( transform, getTransform( instructions[i], mode ) );
+            prefixes[i + 1] = transform;
+        }
+    } );
+
+    std::vector<NavigationTransform> chunkOffsets( numThreads );
+    for( size_t chunk = 1; chunk < numThreads; chunk++ ) {
+        chunkOffsets[chunk] = compose( chunkOffsets[chunk - 1], prefixes[getChunkBegin( chunk )] );
+    }
+
+    runOnChunks( [&] ( size_t chunk ) {
+        if( chunk == 0 )
+            return;
+        for( size_t i = getChunkBegin( chunk ); i < getChunkBegin( chunk + 1 ); i++ ) {
+            prefixes[i + 1] = compose( chunkOffsets[chunk], prefixes[i + 1] );
+        }
+    } );
+
+    return prefixes;
+}
+
+Offset getHeading( Orientation orientation )
+{
+    switch( orientation ) {
+    case Orientation::North:
+        return { 0,1 };
+    case Orientation::South:
+        return { 0,-1 };
+    case Orientation::East:
+        return { 1,0 };
+    case Orientation::West:
+        return { -1,0 };
+    }
+    throw std::runtime_error( "invalid orientation" );
+}
+
+Orientation getOrientation( const Offset& heading )
+{
+    if( heading.y > 0 )
+        return Orientation::North;
+    if( heading.y < 0 )
+        return Orientation::South;
+    if( heading.x > 0 )
+        return Orientation::East;
+    return Orientation::West;
+}
+
+Ship applyTransform( const NavigationTransform& transform, const Ship& ship )
+{
+    Offset heading = getHeading( ship.orientation );
+    Offset position = Offset{ ship.position.x, ship.position.y } + transform.forward * heading + transform.positionOffset;
+    return { { int( position.x ), int( position.y ) }, getOrientation( transform.rotation * heading + transform.directionOffset ) };
+}
+
+ShipWithWaypoint applyTransform( const NavigationTransform& transform, const ShipWithWaypoint& ship )
+{
+    Offset waypoint{ ship.waypoint.x, ship.waypoint.y };
+    Offset position = Offset{ ship.position.x, ship.position.y } + transform.forward * waypoint + transform.positionOffset;
+    Offset newWaypoint = transform.rotation * waypoint + transform.directionOffset;
+    return { { int( position.x ), int( position.y ) }, { int( newWaypoint.x ), int( newWaypoint.y ) } };
+}
+
+int64_t getDistanceAfterRoute( const std::vector<Instruction>& instructions, NavigationMode mode )
+{
+    auto transform = getRouteTransform( instructions, mode );
+    Offset start = mode == NavigationMode::Heading ? Offset{ 1,0 } : Offset{ 10,1 };
+    Offset position = transform.forward * start + transform.positionOffset;
+    return std::abs( position.x ) + std::abs( position.y );
+}
+
 void Day12()
 {
     auto instructions = parseInstructions( "Day12Input.txt" );
@@ -8,6 +8,18 @@
 #include <optional>
 #include <regex>
 #include <map>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <limits>
+#include <span>
+#include <chrono>
+#if defined( _MSC_VER ) && defined( _M_X64 )
+#include <intrin.h>
+#endif
+
+#include "BigUnsigned.h"
 
 struct InputData
 {
@@ -34,43 +46,98 @@ int getTimeDistance( int refTime, int busId )
     return busId - ( refTime % busId );
 }
 
-int getIdWaitTime( const InputData& inputData )
+uint64_t mulHigh( uint64_t a, uint64_t b )
+{
+#ifdef __SIZEOF_INT128__
+    return uint64_t( ( ( unsigned __int128 )a * b ) >> 64 );
+#elif defined( _MSC_VER ) && defined( _M_X64 )
+    return __umulh( a, b );
+#else
+    uint64_t aLow = uint32_t( a ), aHigh = a >> 32, bLow = uint32_t( b ), bHigh = b >> 32;
+    uint64_t mid = aHigh * bLow + ( ( aLow * bLow ) >> 32 );
+    uint64_t mid2 = aLow * bHigh + uint32_t( mid );
+    return aHigh * bHigh + ( mid >> 32 ) + ( mid2 >> 32 );
+#endif
+}
+
+struct Departure
 {
-    std::map<int, int> waitMap;
+    int busId = 0;
+    int waitTime = 0;
+    int64_t product = 0;
+};
 
-    std::transform( begin( inputData.busIds ), end( inputData.busIds ), std::inserter( waitMap, waitMap.end() ),
-        [&inputData] ( int busId ) -> std::pair<int, int> {
-            return { getTimeDistance( inputData.startTime, busId ),busId };
-        } );
+// Answers "first bus after time t" for a fixed schedule. Every bus id gets a precomputed 64-bit
+// reciprocal, so t % busId is two multiplications instead of a division (Lemire's fastmod, exact for
+// 32-bit t and bus ids), and queries allocate nothing.
+class DepartureQuery
+{
+public:
+    explicit DepartureQuery( const std::vector<int>& busIds );
+    Departure getEarliest( uint32_t time ) const;
+    void getEarliest( std::span<const uint32_t> times, std::span<Departure> departures ) const;
+
+private:
+    std::vector<uint32_t> m_busIds;
+    std::vector<uint64_t> m_reciprocals;
+};
 
-    return waitMap.begin()->first * waitMap.begin()->second;
+DepartureQuery::DepartureQuery( const std::vector<int>& busIds )
+{
+    if( busIds.empty() )
+        throw std::runtime_error( "no buses in schedule" );
+    for( auto& busId : busIds ) {
+        if( busId <= 0 )
+            throw std::runtime_error( "invalid bus id" );
+        m_busIds.push_back( uint32_t( busId ) );
+        m_reciprocals.push_back( std::numeric_limits<uint64_t>::max() / uint32_t( busId ) + 1 );
+    }
 }
 
-struct Value
+Departure DepartureQuery::getEarliest( uint32_t time ) const
 {
-    int64_t offset;
-    int64_t add;
-};
+    uint32_t bestWait = std::numeric_limits<uint32_t>::max();
+    uint32_t bestBus = 0;
+    for( size_t i = 0; i < m_busIds.size(); i++ ) {
+        uint32_t remainder = uint32_t( mulHigh( m_reciprocals[i] * time, m_busIds[i] ) );
+        uint32_t wait = m_busIds[i] - remainder;
+        bool better = wait < bestWait;
+        bestWait = better ? wait : bestWait;
+        bestBus = better ? m_busIds[i] : bestBus;
+    }
+    return { int( bestBus ), int( bestWait ), int64_t( bestBus ) * bestWait };
+}
 
-Value getValue( const Value& a, const Value& b, int64_t dif )
-{
-    int64_t resA = a.offset;
-    int64_t resB = b.offset;
-
-    int64_t results[2];
-    for( size_t i = 0; i < 2; i++ ) {
-        while( resA + dif != resB ) {
-            if( resA + dif < resB )
-                resA += std::max( ( resB - resA ) / a.add * a.add, a.add );
-            else
-                resB += std::max( ( resA - resB ) / b.add * b.add, b.add );
-        }
-        results[i] = resA;
-        resB += b.add;
-        resA += a.add;
+void DepartureQuery::getEarliest( std::span<const uint32_t> times, std::span<Departure> departures ) const
+{
+    if( departures.size() < times.size() )
+        throw std::runtime_error( "departure buffer too small" );
+    for( size_t i = 0; i < times.size(); i++ ) {
+        departures[i] = getEarliest( times[i] );
     }
+}
 
-    return { results[0], results[1] - results[0] };
+int getIdWaitTime( const InputData& inputData )
+{
+    return int( DepartureQuery( inputData.busIds ).getEarliest( uint32_t( inputData.startTime ) ).product );
+}
+
+void benchmarkDepartureQueries( const InputData& inputData, size_t numQueries = 10000000 )
+{
+    DepartureQuery query( inputData.busIds );
+    std::vector<uint32_t> times( numQueries );
+    for( size_t i = 0; i < numQueries; i++ ) {
+        times[i] = uint32_t( inputData.startTime + i * 7919 );
+    }
+    std::vector<Departure> departures( numQueries );
+
+    auto start = std::chrono::steady_clock::now();
+    query.getEarliest( times, departures );
+    auto duration = std::chrono::duration<double>( std::chrono::steady_clock::now() - start );
+
+    int64_t checksum = std::accumulate( begin( departures ), end( departures ), int64_t( 0 ),
+        [] ( int64_t sum, const Departure& departure ) { return sum + departure.product; } );
+    std::cout << "Departure queries: " << numQueries / duration.count() / 1e6 << " M queries/s (checksum " << checksum << ")\n";
 }
 
 struct Bus
@@ -89,20 +156,70 @@ std::vector<Bus> getBuses( const std::string& path )
     for( ; std::getline( file, line, ',' ); offset++ ) {
         if( line[0] == 'x' )
             continue;
-        buses.push_back( { std::stoi( line ), offset } );
+        buses.push_back( { std::stoll( line ), offset } );
     }
 
     return buses;
 }
 
-int64_t getAscendingTime( const std::vector<Bus>& buses )
+uint64_t mulMod( uint64_t a, uint64_t b, uint64_t mod )
+{
+#ifdef __SIZEOF_INT128__
+    return uint64_t( ( unsigned __int128 )a * b % mod );
+#else
+    uint64_t result = 0;
+    for( a %= mod; b != 0; b >>= 1 ) {
+        if( b & 1 )
+            result = result >= mod - a ? result - ( mod - a ) : result + a;
+        a = a >= mod - a ? a - ( mod - a ) : a + a;
+    }
+    return result;
+#endif
+}
+
+std::optional<uint64_t> getInverse( uint64_t value, uint64_t mod )
+{
+    int64_t oldR = int64_t( value % mod ), r = int64_t( mod );
+    int64_t oldS = 1, s = 0;
+    while( r != 0 ) {
+        int64_t quotient = oldR / r;
+        oldR = std::exchange( r, oldR - quotient * r );
+        oldS = std::exchange( s, oldS - quotient * s );
+    }
+    if( oldR != 1 )
+        return {};
+    return uint64_t( oldS < 0 ? oldS + int64_t( mod ) : oldS ) % mod;
+}
+
+// Combines the congruences t = -offset (mod busId) one bus at a time. The combined modulus may grow
+// without bound, but every step only needs it reduced by the next bus id, so apart from the running
+// time and modulus all arithmetic stays in 64 bits. IntType must support +, * uint64_t and % uint64_t;
+// BigUnsigned and UInt128 do.
+template<typename IntType = BigUnsigned>
+IntType getAscendingTime( const std::vector<Bus>& buses )
 {
-    Value result = { buses.front().busId, buses.front().busId };
-    for( size_t i = 1; i < buses.size(); i++ ) {
-        result = getValue( result, { buses[i].busId, buses[i].busId }, buses[i].offset );
+    IntType time = 0;
+    IntType modulus = 1;
+    for( auto& bus : buses ) {
+        if( bus.busId <= 0 )
+            throw std::runtime_error( "invalid bus id" );
+        uint64_t busId = uint64_t( bus.busId );
+        uint64_t target = ( busId - uint64_t( bus.offset ) % busId ) % busId;
+
+        uint64_t modulusRem = uint64_t( modulus % busId );
+        uint64_t timeRem = uint64_t( time % busId );
+        uint64_t dif = target >= timeRem ? target - timeRem : target + ( busId - timeRem );
+        uint64_t divisor = std::gcd( modulusRem, busId );
+        if( dif % divisor != 0 )
+            throw std::runtime_error( "inconsistent bus schedule" );
+
+        uint64_t reducedId = busId / divisor;
+        uint64_t steps = reducedId == 1 ? 0 : mulMod( dif / divisor, *getInverse( modulusRem / divisor, reducedId ), reducedId );
+        time = time + modulus * steps;
+        modulus = modulus * reducedId;
     }
 
-    return result.offset;
+    return time;
 }
 
 void Day13()
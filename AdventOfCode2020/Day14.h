@@ -8,149 +8,318 @@
 #include <optional>
 #include <regex>
 #include <map>
-#include <bitset>
 #include <variant>
 #include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <bit>
 
-using IntType = std::bitset<36>;
-
+// A mask compiled at parse time: part 1 maps value to ( value & andMask ) | orMask, part 2 sets the
+// orMask bits of the address and lets the floating bits take every value.
 struct Mask
 {
-    IntType enable;
-    IntType value;
+    uint64_t andMask = std::numeric_limits<uint64_t>::max();
+    uint64_t orMask = 0;
+    uint64_t floating = 0;
 };
 
 struct Memory
 {
-    IntType value;
-    size_t position;
+    uint64_t value;
+    uint64_t position;
 };
 
 using Operation = std::variant<Mask, Memory>;
 
-Mask getMask( const std::string& maskString )
+uint64_t getWordMask( int wordWidth )
 {
-    Mask mask;
-    size_t idx = 0;
-    for( auto it = maskString.rbegin(); it < maskString.rend(); ++it, ++idx ) {
-        if( *it != 'X' ) {
-            mask.enable[idx] = true;
-            if( *it == '1' )
-                mask.value[idx] = true;
+    return wordWidth >= 64 ? std::numeric_limits<uint64_t>::max() : ( uint64_t( 1 ) << wordWidth ) - 1;
+}
+
+Mask getMask( std::string_view maskString, int wordWidth = 36 )
+{
+    if( wordWidth < 1 || wordWidth > 64 || maskString.size() != size_t( wordWidth ) )
+        throw std::runtime_error( "invalid mask width" );
+
+    Mask mask{ 0, 0, 0 };
+    uint64_t bit = 1;
+    for( auto it = maskString.rbegin(); it < maskString.rend(); ++it, bit <<= 1 ) {
+        switch( *it ) {
+        case 'X':
+            mask.andMask |= bit;
+            mask.floating |= bit;
+            break;
+        case '1':
+            mask.orMask |= bit;
+            break;
+        case '0':
+            break;
+        default:
+            throw std::runtime_error( "invalid mask" );
         }
     }
     return mask;
 }
 
-Memory getMemory( const std::string& posString, const std::string& valueString )
+Memory getMemory( const std::string& posString, const std::string& valueString, int wordWidth = 36 )
 {
-    return { std::stoull( valueString ) ,std::stoull( posString ) };
+    return { std::stoull( valueString ) & getWordMask( wordWidth ), std::stoull( posString ) & getWordMask( wordWidth ) };
 }
 
-Operation getOperation( const std::string& string )
+Operation getOperation( const std::string& string, int wordWidth = 36 )
 {
-    static std::regex maskRegex( R"(mask = ([X|0|1]{36}))" );
     static std::regex memRegex( R"(mem\[(\d+)\] = (\d+))" );
+    constexpr std::string_view maskPrefix = "mask = ";
+
+    if( string.starts_with( maskPrefix ) )
+        return getMask( std::string_view( string ).substr( maskPrefix.size() ), wordWidth );
 
     std::smatch match;
-    if( std::regex_match( string, match, maskRegex ) )
-        return getMask( match[1] );
-    std::regex_match( string, match, memRegex );
-    return getMemory( match[1], match[2] );
+    if( !std::regex_match( string, match, memRegex ) )
+        throw std::runtime_error( "invalid operation" );
+    return getMemory( match[1], match[2], wordWidth );
 }
 
-std::vector<Operation> getOperations( const std::string& path )
+std::vector<Operation> getOperations( const std::string& path, int wordWidth = 36 )
 {
     std::vector<Operation> operations;
     std::ifstream file( path );
     for( std::string line; std::getline( file, line );) {
-        operations.push_back( getOperation( line ) );
+        operations.push_back( getOperation( line, wordWidth ) );
     }
 
     return operations;
 }
 
-std::bitset<36> applyMask( const IntType& value, const Mask& mask )
+uint64_t applyMask( uint64_t value, const Mask& mask )
+{
+    return ( value & mask.andMask ) | mask.orMask;
+}
+
+// Open-addressing hash table (linear probing, power of two capacity) from address to value. Slots
+// are stored inline, so a write is a few probes in one array instead of a tree node allocation.
+class DockingMemory
 {
-    return value & ~mask.enable | mask.value;
+public:
+    explicit DockingMemory( size_t expectedNumAddresses = 0 );
+    void write( uint64_t address, uint64_t value );
+    uint64_t getSum() const;
+    size_t size() const { return m_size; }
+
+private:
+    static constexpr uint64_t emptyAddress = std::numeric_limits<uint64_t>::max();
+
+    struct Slot
+    {
+        uint64_t address = emptyAddress;
+        uint64_t value = 0;
+    };
+
+    size_t getSlotIdx( uint64_t address ) const { return size_t( ( address * 0x9E3779B97F4A7C15ull ) >> m_shift ); }
+    void resize( size_t capacity );
+
+    std::vector<Slot> m_slots;
+    int m_shift = 64;
+    size_t m_size = 0;
+    std::optional<uint64_t> m_emptyAddressValue;
+};
+
+DockingMemory::DockingMemory( size_t expectedNumAddresses )
+{
+    resize( std::bit_ceil( std::max<size_t>( expectedNumAddresses * 2, 16 ) ) );
+}
+
+void DockingMemory::resize( size_t capacity )
+{
+    auto oldSlots = std::move( m_slots );
+    m_slots.assign( capacity, {} );
+    m_shift = 64 - std::countr_zero( capacity );
+    m_size = 0;
+    for( auto& slot : oldSlots ) {
+        if( slot.address != emptyAddress )
+            write( slot.address, slot.value );
+    }
+}
+
+void DockingMemory::write( uint64_t address, uint64_t value )
+{
+    if( address == emptyAddress ) {
+        m_emptyAddressValue = value;
+        return;
+    }
+
+    size_t mask = m_slots.size() - 1;
+    for( size_t idx = getSlotIdx( address );; idx = ( idx + 1 ) & mask ) {
+        auto& slot = m_slots[idx];
+        if( slot.address == address ) {
+            slot.value = value;
+            return;
+        }
+        if( slot.address == emptyAddress ) {
+            slot = { address, value };
+            if( ++m_size * 2 > m_slots.size() )
+                resize( m_slots.size() * 2 );
+            return;
+        }
+    }
+}
+
+uint64_t DockingMemory::getSum() const
+{
+    uint64_t sum = m_emptyAddressValue.value_or( 0 );
+    for( auto& slot : m_slots ) {
+        if( slot.address != emptyAddress )
+            sum += slot.value;
+    }
+    return sum;
+}
+
+size_t estimateNumWrites( const std::vector<Operation>& operations, bool floatingAddresses )
+{
+    constexpr size_t maxEstimate = size_t( 1 ) << 24;
+
+    size_t numWrites = 0;
+    Mask mask;
+    for( auto& operation : operations ) {
+        if( auto newMaskValue = std::get_if<Mask>( &operation ) )
+            mask = *newMaskValue;
+        else
+            numWrites += floatingAddresses ? size_t( 1 ) << std::popcount( mask.floating ) : 1;
+        if( numWrites >= maxEstimate )
+            return maxEstimate;
+    }
+    return numWrites;
 }
 
 size_t getSumOfResults( const std::vector<Operation>& operations )
 {
-    std::map<size_t, IntType> memory;
+    DockingMemory memory( estimateNumWrites( operations, false ) );
     Mask mask;
     for( auto& operation : operations ) {
         if( auto newMaskValue = std::get_if<Mask>( &operation ) )
             mask = *newMaskValue;
         else {
             auto memOp = std::get<Memory>( operation );
-            memory[memOp.position] = applyMask( memOp.value, mask );
+            memory.write( memOp.position, applyMask( memOp.value, mask ) );
         }
     }
 
-    return std::accumulate( begin( memory ), end( memory ), 0ull,
-        [] ( size_t sum, const auto& memPair ) {
-            return sum + memPair.second.to_ullong();
-        } );
+    return memory.getSum();
 }
 
-std::vector<size_t> getSetPositions( const IntType& value )
+// Calls func for every address matching base on the non-floating bits. ( subset - floating ) & floating
+// steps through all subsets of the floating bits, so each address costs a handful of instructions.
+template<typename Func>
+void forEachAdress( uint64_t base, uint64_t floating, Func func )
 {
-    std::vector<size_t> setPositions;
+    base &= ~floating;
+    uint64_t subset = 0;
+    do {
+        func( base | subset );
+        subset = ( subset - floating ) & floating;
+    } while( subset != 0 );
+}
 
-    for( size_t i = 0; i < value.size(); i++ ) {
-        if( !value[i] )
-            setPositions.push_back( i );
+std::vector<size_t> getAdresses( uint64_t pos, const Mask& mask )
+{
+    std::vector<size_t> adresses;
+    forEachAdress( pos | mask.orMask, mask.floating,
+        [&adresses] ( uint64_t adress ) { adresses.push_back( adress ); } );
+    return adresses;
+}
+
+size_t getSumOfResults2( const std::vector<Operation>& operations )
+{
+    DockingMemory memory( estimateNumWrites( operations, true ) );
+    Mask mask;
+    for( auto& operation : operations ) {
+        if( auto newMaskValue = std::get_if<Mask>( &operation ) )
+            mask = *newMaskValue;
+        else {
+            auto memOp = std::get<Memory>( operation );
+            forEachAdress( memOp.position | mask.orMask, mask.floating,
+                [&memory, &memOp] ( uint64_t adress ) { memory.write( adress, memOp.value ); } );
+        }
     }
 
-    return setPositions;
+    return memory.getSum();
 }
 
-size_t getAdress( const IntType& initialAdress, const std::vector<size_t>& positions, const IntType& setMask )
+// Set of addresses matching fixed on every bit not set in floating.
+struct AddressPattern
 {
-    IntType adress = initialAdress;
-    for( size_t i = 0; i < positions.size(); i++ ) {
-        adress[positions[i]] = setMask[i];
-    }
-    return adress.to_ullong();
+    uint64_t fixed;
+    uint64_t floating;
+};
+
+uint64_t getNumAddresses( const AddressPattern& pattern )
+{
+    int numFloating = std::popcount( pattern.floating );
+    return numFloating >= 64 ? 0 : uint64_t( 1 ) << numFloating;
 }
 
-std::vector<size_t> getAdresses( const IntType& pos, const Mask& mask )
+bool intersects( const AddressPattern& a, const AddressPattern& b )
 {
-    std::vector<size_t> adresses;
-    auto tempAdress = pos | mask.value;
-    if( !( ~mask.enable ).any() )
-        return { tempAdress.to_ullong() };
-
-    auto setPositions = getSetPositions( mask.enable );
-    size_t maxVal = 1ull << setPositions.size();
-    for( size_t i = 0; i < maxVal; i++ ) {
-        adresses.push_back( getAdress( tempAdress, setPositions, i ) );
+    return ( ( a.fixed ^ b.fixed ) & ~a.floating & ~b.floating ) == 0;
+}
+
+// Splits a \ b into disjoint patterns: for every bit that floats in a but is fixed in b, one piece takes
+// the opposite of b's bit there and b's bits on the split bits before it.
+void subtract( const AddressPattern& a, const AddressPattern& b, std::vector<AddressPattern>& result )
+{
+    if( !intersects( a, b ) ) {
+        result.push_back( a );
+        return;
     }
 
-    return adresses;
+    AddressPattern rest = a;
+    for( uint64_t splitBits = a.floating & ~b.floating; splitBits != 0; splitBits &= splitBits - 1 ) {
+        uint64_t bit = splitBits & ( ~splitBits + 1 );
+        rest.floating &= ~bit;
+        result.push_back( { ( rest.fixed & ~bit ) | ( ~b.fixed & bit ), rest.floating } );
+        rest.fixed = ( rest.fixed & ~bit ) | ( b.fixed & bit );
+    }
 }
 
-size_t getSumOfResults2( const std::vector<Operation>& operations )
+// Part 2 without expanding floating addresses: walking the writes backwards, each write only counts the
+// addresses that no later write overwrites, found by subtracting the later patterns from its own.
+size_t getSumOfResultsSymbolic( const std::vector<Operation>& operations )
 {
-    std::map<size_t, IntType> memory;
+    std::vector<std::pair<AddressPattern, uint64_t>> writes;
     Mask mask;
     for( auto& operation : operations ) {
         if( auto newMaskValue = std::get_if<Mask>( &operation ) )
             mask = *newMaskValue;
         else {
             auto memOp = std::get<Memory>( operation );
-            auto adresses = getAdresses( memOp.position, mask );
-            for( auto& adress : adresses ) {
-                memory[adress] = memOp.value;
-            }
+            writes.push_back( { { ( memOp.position | mask.orMask ) & ~mask.floating, mask.floating }, memOp.value } );
         }
     }
 
-    return std::accumulate( begin( memory ), end( memory ), 0ull,
-        [] ( size_t sum, const auto& memPair ) {
-            return sum + memPair.second.to_ullong();
-        } );
+    size_t sum = 0;
+    std::vector<AddressPattern> laterWrites;
+    std::vector<AddressPattern> pieces;
+    std::vector<AddressPattern> nextPieces;
+    for( auto it = writes.rbegin(); it != writes.rend(); ++it ) {
+        auto& [pattern, value] = *it;
+        pieces.assign( 1, pattern );
+        for( auto& laterWrite : laterWrites ) {
+            if( pieces.empty() )
+                break;
+            nextPieces.clear();
+            for( auto& piece : pieces ) {
+                subtract( piece, laterWrite, nextPieces );
+            }
+            std::swap( pieces, nextPieces );
+        }
+
+        for( auto& piece : pieces ) {
+            sum += getNumAddresses( piece ) * value;
+        }
+        laterWrites.push_back( pattern );
+    }
+    return sum;
 }
 
 void Day14()
@@ -159,5 +328,5 @@ void Day14()
 
     std::cout << "Day14:\n";
     std::cout << "Part1: Sum of results: " << getSumOfResults( operations ) << "\n";
-    std::cout << "Part2: Sum of results: " << getSumOfResults2( operations ) << "\n";
+    std::cout << "Part2: Sum of results: " << getSumOfResultsSymbolic( operations ) << "\n";
 }
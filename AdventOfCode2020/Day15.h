@@ -7,6 +7,31 @@
 #include <optional>
 #include <regex>
 #include <map>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <utility>
+#include <filesystem>
+#include <memory>
+#include <functional>
+#include <chrono>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
 
 std::vector<int64_t> getStartNumbers( const std::string& path )
 {
@@ -41,11 +66,415 @@ int64_t getNumberSpoken( const std::vector<int64_t>& startNumbers, int64_t numTo
     return newNum;
 }
 
+// Zero-initialized buffer of uint32_t taken straight from the OS, so pages are only zeroed when they are
+// first touched. On Linux the mapping is marked for transparent huge pages to cut TLB misses.
+class LazyZeroBuffer
+{
+public:
+    LazyZeroBuffer( size_t size, bool useHugePages );
+    ~LazyZeroBuffer();
+    LazyZeroBuffer( const LazyZeroBuffer& ) = delete;
+    LazyZeroBuffer& operator=( const LazyZeroBuffer& ) = delete;
+
+    uint32_t* data() { return m_data; }
+    const uint32_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    uint32_t* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+LazyZeroBuffer::LazyZeroBuffer( size_t size, bool useHugePages ) : m_size( size )
+{
+    if( size == 0 )
+        return;
+#ifdef _WIN32
+    m_data = static_cast<uint32_t*>( VirtualAlloc( nullptr, size * sizeof( uint32_t ), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE ) );
+    if( !m_data )
+        throw std::bad_alloc();
+#else
+    void* data = mmap( nullptr, size * sizeof( uint32_t ), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( data == MAP_FAILED )
+        throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+    if( useHugePages )
+        madvise( data, size * sizeof( uint32_t ), MADV_HUGEPAGE );
+#endif
+    m_data = static_cast<uint32_t*>( data );
+#endif
+}
+
+LazyZeroBuffer::~LazyZeroBuffer()
+{
+    if( !m_data )
+        return;
+#ifdef _WIN32
+    VirtualFree( m_data, 0, MEM_RELEASE );
+#else
+    munmap( m_data, m_size * sizeof( uint32_t ) );
+#endif
+}
+
+// Turn (plus one, 0 meaning never) in which each number was last spoken. Numbers below hotSize live in a
+// small separate array that stays in cache; they make up most of the lookups.
+class LastSpokenTable
+{
+public:
+    LastSpokenTable( size_t size, size_t hotSize, bool useHugePages )
+        : m_hot( std::min( size, hotSize ) ), m_cold( size - m_hot.size(), useHugePages ) {}
+
+    uint32_t exchange( uint32_t number, uint32_t turn )
+    {
+        uint32_t& slot = number < m_hot.size() ? m_hot[number] : m_cold.data()[number - m_hot.size()];
+        return std::exchange( slot, turn );
+    }
+
+    void prefetch( uint32_t number ) const
+    {
+        const uint32_t* slot = number < m_hot.size() ? &m_hot[number] : &m_cold.data()[number - m_hot.size()];
+#if defined( _MSC_VER )
+        _mm_prefetch( reinterpret_cast<const char*>( slot ), _MM_HINT_T0 );
+#else
+        __builtin_prefetch( slot, 1 );
+#endif
+    }
+
+    uint32_t at( uint32_t number ) const
+    {
+        return number < m_hot.size() ? m_hot[number] : m_cold.data()[number - m_hot.size()];
+    }
+
+    size_t size() const { return m_hot.size() + m_cold.size(); }
+
+private:
+    std::vector<uint32_t> m_hot;
+    LazyZeroBuffer m_cold;
+};
+
+namespace
+{
+    constexpr char snapshotMagic[4] = { 'D','1','5','S' };
+
+    void writeVarint( std::string& buffer, uint64_t value )
+    {
+        for( ; value >= 0x80; value >>= 7 ) {
+            buffer.push_back( char( value | 0x80 ) );
+        }
+        buffer.push_back( char( value ) );
+    }
+
+    uint64_t readVarint( std::istream& stream )
+    {
+        uint64_t value = 0;
+        for( int shift = 0; shift < 64; shift += 7 ) {
+            int byte = stream.get();
+            if( byte == EOF )
+                throw std::runtime_error( "truncated snapshot" );
+            value |= uint64_t( byte & 0x7F ) << shift;
+            if( !( byte & 0x80 ) )
+                return value;
+        }
+        throw std::runtime_error( "invalid snapshot" );
+    }
+}
+
+// Memory game state: the number spoken in 0-based turn m_turn plus the table of earlier turns. It can be
+// saved to and restored from a snapshot, which stores only the numbers spoken so far as varint-encoded
+// (number delta, turn) pairs.
+class MemoryGame
+{
+public:
+    MemoryGame( const std::vector<int64_t>& startNumbers, size_t tableSize, bool useHugePages = true, size_t hotSize = 1 << 16 );
+    MemoryGame( const std::filesystem::path& snapshot, const std::vector<int64_t>& startNumbers, size_t tableSize,
+        bool useHugePages = true, size_t hotSize = 1 << 16 );
+
+    uint32_t getNumSpoken() const { return m_turn + 1; }
+    uint32_t getLastSpoken() const { return m_lastNumber; }
+    void playUntil( uint32_t numSpoken );
+    void playUntilPrefetched( uint32_t numSpoken );
+    void save( const std::filesystem::path& snapshot ) const;
+
+private:
+    std::vector<int64_t> m_startNumbers;
+    LastSpokenTable m_lastSpoken;
+    uint32_t m_turn = 0;
+    uint32_t m_lastNumber = 0;
+};
+
+MemoryGame::MemoryGame( const std::vector<int64_t>& startNumbers, size_t tableSize, bool useHugePages, size_t hotSize )
+    : m_startNumbers( startNumbers ), m_lastSpoken( tableSize, hotSize, useHugePages ), m_turn( uint32_t( startNumbers.size() ) )
+{
+    if( startNumbers.empty() )
+        throw std::runtime_error( "invalid memory game" );
+    for( uint32_t i = 0; i < startNumbers.size(); i++ ) {
+        if( startNumbers[i] < 0 || size_t( startNumbers[i] ) >= tableSize )
+            throw std::runtime_error( "start number out of range" );
+        m_lastSpoken.exchange( uint32_t( startNumbers[i] ), i + 1 );
+    }
+}
+
+MemoryGame::MemoryGame( const std::filesystem::path& snapshot, const std::vector<int64_t>& startNumbers, size_t tableSize,
+    bool useHugePages, size_t hotSize )
+    : m_startNumbers( startNumbers ), m_lastSpoken( tableSize, hotSize, useHugePages )
+{
+    std::ifstream file( snapshot, std::ios::binary );
+    char magic[4] = {};
+    file.read( magic, sizeof( magic ) );
+    if( !file || !std::equal( std::begin( magic ), std::end( magic ), snapshotMagic ) )
+        throw std::runtime_error( "invalid snapshot " + snapshot.string() );
+
+    std::vector<int64_t> snapshotStart( readVarint( file ) );
+    for( auto& number : snapshotStart ) {
+        number = int64_t( readVarint( file ) );
+    }
+    if( snapshotStart != startNumbers )
+        throw std::runtime_error( "snapshot " + snapshot.string() + " belongs to another game" );
+
+    m_turn = uint32_t( readVarint( file ) );
+    m_lastNumber = uint32_t( readVarint( file ) );
+    uint64_t numEntries = readVarint( file );
+    uint64_t number = 0;
+    for( uint64_t i = 0; i < numEntries; i++ ) {
+        number += readVarint( file );
+        if( number >= tableSize )
+            throw std::runtime_error( "snapshot " + snapshot.string() + " does not fit the table" );
+        m_lastSpoken.exchange( uint32_t( number ), uint32_t( readVarint( file ) ) );
+    }
+}
+
+void MemoryGame::playUntil( uint32_t numSpoken )
+{
+    if( numSpoken > m_lastSpoken.size() )
+        throw std::runtime_error( "memory game table too small" );
+
+    uint32_t newNum = m_lastNumber;
+    uint32_t idx = m_turn;
+    for( ; idx < numSpoken - 1; ++idx ) {
+        uint32_t lastTurn = m_lastSpoken.exchange( newNum, idx + 1 );
+        newNum = lastTurn != 0 ? idx + 1 - lastTurn : 0;
+    }
+    m_turn = idx;
+    m_lastNumber = newNum;
+}
+
+// Experimental: splits each turn into load, prefetch of the next number's slot, then the store, so the
+// next cache miss is already in flight while the store retires.
+void MemoryGame::playUntilPrefetched( uint32_t numSpoken )
+{
+    if( numSpoken > m_lastSpoken.size() )
+        throw std::runtime_error( "memory game table too small" );
+
+    uint32_t newNum = m_lastNumber;
+    uint32_t idx = m_turn;
+    for( ; idx < numSpoken - 1; ++idx ) {
+        uint32_t lastTurn = m_lastSpoken.at( newNum );
+        uint32_t nextNum = lastTurn != 0 ? idx + 1 - lastTurn : 0;
+        m_lastSpoken.prefetch( nextNum );
+        m_lastSpoken.exchange( newNum, idx + 1 );
+        newNum = nextNum;
+    }
+    m_turn = idx;
+    m_lastNumber = newNum;
+}
+
+void MemoryGame::save( const std::filesystem::path& snapshot ) const
+{
+    std::string entries;
+    uint64_t numEntries = 0;
+    uint64_t previousNumber = 0;
+    for( uint32_t number = 0; number < m_lastSpoken.size(); number++ ) {
+        if( uint32_t turn = m_lastSpoken.at( number ); turn != 0 ) {
+            writeVarint( entries, number - previousNumber );
+            writeVarint( entries, turn );
+            previousNumber = number;
+            numEntries++;
+        }
+    }
+
+    std::string header( std::begin( snapshotMagic ), std::end( snapshotMagic ) );
+    writeVarint( header, m_startNumbers.size() );
+    for( auto& number : m_startNumbers ) {
+        writeVarint( header, uint64_t( number ) );
+    }
+    writeVarint( header, m_turn );
+    writeVarint( header, m_lastNumber );
+    writeVarint( header, numEntries );
+
+    auto tmpPath = snapshot;
+    tmpPath += ".tmp";
+    {
+        std::ofstream file( tmpPath, std::ios::binary );
+        file.write( header.data(), header.size() );
+        file.write( entries.data(), entries.size() );
+        if( !file )
+            throw std::runtime_error( "could not write snapshot " + snapshot.string() );
+    }
+    std::filesystem::rename( tmpPath, snapshot );
+}
+
+size_t getTableSize( const std::vector<int64_t>& startNumbers, uint32_t numToSpeak )
+{
+    int64_t maxStart = *std::max_element( begin( startNumbers ), end( startNumbers ) );
+    if( maxStart < 0 || maxStart >= std::numeric_limits<uint32_t>::max() )
+        throw std::runtime_error( "start number out of range" );
+    return std::max<size_t>( numToSpeak, size_t( maxStart ) + 1 );
+}
+
+int64_t getNumberSpokenFlat( const std::vector<int64_t>& startNumbers, uint32_t numToSpeak, bool useHugePages = true, size_t hotSize = 1 << 16 )
+{
+    if( numToSpeak == 0 || startNumbers.empty() )
+        throw std::runtime_error( "invalid memory game" );
+    if( numToSpeak <= startNumbers.size() )
+        return startNumbers[numToSpeak - 1];
+
+    MemoryGame game( startNumbers, getTableSize( startNumbers, numToSpeak ), useHugePages, hotSize );
+    game.playUntil( numToSpeak );
+    return game.getLastSpoken();
+}
+
+// Resumes from the latest snapshot in snapshotDir at or before numToSpeak and writes a new snapshot every
+// snapshotInterval turns on the way. Snapshot names carry a hash of the start numbers and the turn.
+int64_t getNumberSpokenCheckpointed( const std::vector<int64_t>& startNumbers, uint32_t numToSpeak,
+    const std::filesystem::path& snapshotDir, uint32_t snapshotInterval, bool useHugePages = true )
+{
+    if( numToSpeak == 0 || startNumbers.empty() || snapshotInterval == 0 )
+        throw std::runtime_error( "invalid memory game" );
+    if( numToSpeak <= startNumbers.size() )
+        return startNumbers[numToSpeak - 1];
+
+    size_t gameHash = 0;
+    for( auto& number : startNumbers ) {
+        gameHash = gameHash * 1000003 ^ std::hash<int64_t>()( number );
+    }
+    std::string prefix = "memory_game_" + std::to_string( gameHash ) + "_";
+
+    std::filesystem::create_directories( snapshotDir );
+    std::vector<std::pair<uint32_t, std::filesystem::path>> snapshots;
+    for( auto& entry : std::filesystem::directory_iterator( snapshotDir ) ) {
+        auto name = entry.path().filename().string();
+        if( !name.starts_with( prefix ) || entry.path().extension() != ".snapshot" )
+            continue;
+        uint64_t numSpoken = std::stoull( name.substr( prefix.size() ) );
+        if( numSpoken <= numToSpeak )
+            snapshots.push_back( { uint32_t( numSpoken ), entry.path() } );
+    }
+    std::sort( snapshots.rbegin(), snapshots.rend() );
+
+    size_t tableSize = getTableSize( startNumbers, numToSpeak );
+    std::unique_ptr<MemoryGame> game;
+    for( auto& [numSpoken, path] : snapshots ) {
+        try {
+            game = std::make_unique<MemoryGame>( path, startNumbers, tableSize, useHugePages );
+            break;
+        }
+        catch( const std::runtime_error& ) {
+        }
+    }
+    if( !game )
+        game = std::make_unique<MemoryGame>( startNumbers, tableSize, useHugePages );
+
+    for( uint32_t next = ( game->getNumSpoken() / snapshotInterval + 1 ) * snapshotInterval; next < numToSpeak; next += snapshotInterval ) {
+        game->playUntil( next );
+        game->save( snapshotDir / ( prefix + std::to_string( next ) + ".snapshot" ) );
+    }
+    game->playUntil( numToSpeak );
+    return game->getLastSpoken();
+}
+
+// Counts last-level cache misses of the calling thread through perf_event_open where the kernel allows
+// it; elsewhere stop() returns nothing.
+class CacheMissCounter
+{
+public:
+    CacheMissCounter()
+    {
+#ifdef __linux__
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof( attr );
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = int( syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 ) );
+#endif
+    }
+
+    ~CacheMissCounter()
+    {
+#ifdef __linux__
+        if( m_fd >= 0 )
+            close( m_fd );
+#endif
+    }
+
+    CacheMissCounter( const CacheMissCounter& ) = delete;
+    CacheMissCounter& operator=( const CacheMissCounter& ) = delete;
+
+    void start()
+    {
+#ifdef __linux__
+        if( m_fd >= 0 ) {
+            ioctl( m_fd, PERF_EVENT_IOC_RESET, 0 );
+            ioctl( m_fd, PERF_EVENT_IOC_ENABLE, 0 );
+        }
+#endif
+    }
+
+    std::optional<uint64_t> stop()
+    {
+#ifdef __linux__
+        uint64_t count = 0;
+        if( m_fd >= 0 && ioctl( m_fd, PERF_EVENT_IOC_DISABLE, 0 ) == 0 && read( m_fd, &count, sizeof( count ) ) == sizeof( count ) )
+            return count;
+#endif
+        return {};
+    }
+
+private:
+    int m_fd = -1;
+};
+
+template<typename Func>
+void benchmarkGameVariant( const std::string& name, uint32_t numTurns, Func func )
+{
+    CacheMissCounter cacheMisses;
+    cacheMisses.start();
+    auto start = std::chrono::steady_clock::now();
+    int64_t result = func();
+    auto duration = std::chrono::duration<double>( std::chrono::steady_clock::now() - start );
+    auto misses = cacheMisses.stop();
+
+    std::cout << name << ": " << numTurns / duration.count() / 1e6 << " M turns/s";
+    if( misses )
+        std::cout << ", " << double( *misses ) / numTurns << " cache misses/turn";
+    std::cout << " (result " << result << ")\n";
+}
+
+// Compares the table layouts on the same game. The std::map baseline only runs up to mapTurns because
+// it is an order of magnitude slower.
+void benchmarkMemoryGame( const std::vector<int64_t>& startNumbers, uint32_t numTurns = 30000000, uint32_t mapTurns = 3000000 )
+{
+    size_t tableSize = getTableSize( startNumbers, numTurns );
+    std::cout << "Memory game benchmark, " << numTurns << " turns:\n";
+    benchmarkGameVariant( "std::map (" + std::to_string( mapTurns ) + " turns)", mapTurns,
+        [&] { return getNumberSpoken( startNumbers, mapTurns ); } );
+    benchmarkGameVariant( "flat", numTurns,
+        [&] { MemoryGame game( startNumbers, tableSize, false, 0 ); game.playUntil( numTurns ); return game.getLastSpoken(); } );
+    benchmarkGameVariant( "flat, huge pages", numTurns,
+        [&] { MemoryGame game( startNumbers, tableSize, true, 0 ); game.playUntil( numTurns ); return game.getLastSpoken(); } );
+    benchmarkGameVariant( "hot/cold split", numTurns,
+        [&] { MemoryGame game( startNumbers, tableSize ); game.playUntil( numTurns ); return game.getLastSpoken(); } );
+    benchmarkGameVariant( "hot/cold split, prefetch", numTurns,
+        [&] { MemoryGame game( startNumbers, tableSize ); game.playUntilPrefetched( numTurns ); return game.getLastSpoken(); } );
+}
+
 void Day15()
 {
     auto numbers = getStartNumbers( "Day15Input.txt" );
 
     std::cout << "Day15:\n";
-    std::cout << "Part1: 2020th number spoken: " << getNumberSpoken( numbers, 2020 ) << "\n";
-    std::cout << "Part1: 30'000'000th number spoken: " << getNumberSpoken( numbers, 30000000 ) << "\n";
+    std::cout << "Part1: 2020th number spoken: " << getNumberSpokenFlat( numbers, 2020 ) << "\n";
+    std::cout << "Part1: 30'000'000th number spoken: " << getNumberSpokenFlat( numbers, 30000000 ) << "\n";
 }
@@ -11,6 +11,14 @@
 #include <set>
 #include <sstream>
 #include <list>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <bit>
+#include <span>
+#include <thread>
+#include <iterator>
 
 struct FieldData
 {
@@ -31,41 +39,97 @@ struct TicketData
     std::vector<int> values;
 };
 
+// Nearby ticket values stored column-major in one block: value( ticket, column ) is at
+// column * numTickets + ticket, so every column is one contiguous run.
+struct TicketColumns
+{
+    size_t numTickets = 0;
+    size_t numColumns = 0;
+    std::vector<int32_t> values;
+
+    std::span<const int32_t> column( size_t column ) const { return { values.data() + column * numTickets, numTickets }; }
+};
+
 struct InputData
 {
     std::vector<FieldData> fields;
     TicketData myTicket;
-    std::vector<TicketData> nearbyTickets;
+    TicketColumns nearbyTickets;
 };
 
+namespace
+{
+    std::string_view getLine( std::string_view text, size_t& pos )
+    {
+        size_t end = std::min( text.find( '\n', pos ), text.size() );
+        std::string_view line = text.substr( pos, end - pos );
+        pos = end + 1;
+        if( !line.empty() && line.back() == '\r' )
+            line.remove_suffix( 1 );
+        return line;
+    }
+
+    template<typename Func>
+    void parseTicketLine( std::string_view line, Func onValue )
+    {
+        size_t pos = 0;
+        while( pos < line.size() ) {
+            int value = 0;
+            size_t start = pos;
+            for( ; pos < line.size() && line[pos] >= '0' && line[pos] <= '9'; pos++ ) {
+                value = value * 10 + ( line[pos] - '0' );
+            }
+            if( pos == start || ( pos < line.size() && line[pos] != ',' ) )
+                throw std::runtime_error( "invalid ticket: " + std::string( line ) );
+            onValue( value );
+            pos++;
+        }
+    }
+}
+
 InputData getInputData( const std::string& path )
 {
+    std::ifstream file( path, std::ios::binary );
+    std::string text{ std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() };
+
     InputData inputData;
-    std::ifstream file( path );
     std::regex fieldRegex( R"((.*): (\d+)-(\d+) or (\d+)-(\d+))" );
-    std::string line;
-    for( ; std::getline( file, line ); ) {
+    size_t pos = 0;
+    while( pos < text.size() ) {
+        std::string line( getLine( text, pos ) );
         std::smatch match;
         if( !std::regex_match( line, match, fieldRegex ) )
             break;
         inputData.fields.push_back( { match[1],std::stoi( match[2] ),std::stoi( match[3] ) ,std::stoi( match[4] ) ,std::stoi( match[5] ) } );
     }
-    std::getline( file, line );
-    std::getline( file, line );
-    std::stringstream myTicketLine( line );
+    getLine( text, pos );
+    parseTicketLine( getLine( text, pos ), [&] ( int value ) { inputData.myTicket.values.push_back( value ); } );
+    getLine( text, pos );
+    getLine( text, pos );
 
-    for( std::string value; std::getline( myTicketLine, value, ',' ); ) {
-        inputData.myTicket.values.push_back( std::stoi( value ) );
+    auto& tickets = inputData.nearbyTickets;
+    size_t ticketStart = std::min( pos, text.size() );
+    for( size_t linePos = ticketStart; linePos < text.size(); ) {
+        tickets.numTickets += !getLine( text, linePos ).empty();
     }
-    std::getline( file, line );
-    std::getline( file, line );
+    tickets.numColumns = inputData.myTicket.values.size();
+    tickets.values.resize( tickets.numTickets * tickets.numColumns );
 
-    for( std::string value; std::getline( file, line ); ) {
-        std::stringstream ticketLine( line );
-        inputData.nearbyTickets.push_back( {} );
-        for( std::string value; std::getline( ticketLine, value, ',' ); ) {
-            inputData.nearbyTickets.back().values.push_back( std::stoi( value ) );
-        }
+    size_t ticket = 0;
+    for( pos = ticketStart; pos < text.size(); ) {
+        auto line = getLine( text, pos );
+        if( line.empty() )
+            continue;
+        size_t column = 0;
+        parseTicketLine( line,
+            [&] ( int value ) {
+                if( column >= tickets.numColumns )
+                    throw std::runtime_error( "ticket with wrong number of values" );
+                tickets.values[column++ * tickets.numTickets + ticket] = value;
+            } );
+        if( column != tickets.numColumns )
+            throw std::runtime_error( "ticket with wrong number of values" );
+        ticket++;
     }
 
     return inputData;
@@ -80,90 +144,250 @@ bool isValueValid( int value, const std::vector<FieldData>& fields )
     return false;
 }
 
-int getSumInvalidData( const InputData& inputData )
+// Bit i of getMask( value ) is set when field i accepts value. Small value domains use a dense table, so
+// a lookup is one load. Larger domains fall back to the sorted boundaries of all ranges and a binary
+// search over the elementary intervals between them.
+class FieldMaskTable
 {
-    return std::accumulate( begin( inputData.nearbyTickets ), end( inputData.nearbyTickets ), 0ll,
-        [&inputData] ( int64_t sum, const TicketData& ticket ) {
-            return sum + std::accumulate( begin( ticket.values ), end( ticket.values ), 0ll,
-                [&inputData] ( int64_t sum, int value ) {
-                    return sum + ( isValueValid( value, inputData.fields ) ? 0 : value );
-                } );
-        } );
+public:
+    explicit FieldMaskTable( const std::vector<FieldData>& fields, int64_t maxDenseSize = 1 << 24 );
+    uint64_t getMask( int value ) const;
+    bool isValid( int value ) const { return getMask( value ) != 0; }
+
+private:
+    int m_minValue = 0;
+    std::vector<uint64_t> m_denseMasks;
+    std::vector<int> m_boundaries;
+    std::vector<uint64_t> m_intervalMasks;
+};
+
+FieldMaskTable::FieldMaskTable( const std::vector<FieldData>& fields, int64_t maxDenseSize )
+{
+    if( fields.size() > 64 )
+        throw std::runtime_error( "too many fields" );
+    if( fields.empty() )
+        return;
+
+    std::vector<std::pair<int, int>> ranges;
+    for( auto& field : fields ) {
+        ranges.push_back( { field.min1, field.max1 } );
+        ranges.push_back( { field.min2, field.max2 } );
+    }
+
+    int minValue = std::numeric_limits<int>::max();
+    int maxValue = std::numeric_limits<int>::min();
+    for( auto& [min, max] : ranges ) {
+        minValue = std::min( minValue, min );
+        maxValue = std::max( maxValue, max );
+    }
+
+    if( int64_t( maxValue ) - minValue + 1 <= maxDenseSize ) {
+        m_minValue = minValue;
+        m_denseMasks.resize( size_t( int64_t( maxValue ) - minValue + 1 ) );
+        for( size_t i = 0; i < ranges.size(); i++ ) {
+            for( int64_t value = ranges[i].first; value <= ranges[i].second; value++ ) {
+                m_denseMasks[size_t( value - minValue )] |= uint64_t( 1 ) << ( i / 2 );
+            }
+        }
+        return;
+    }
+
+    for( auto& [min, max] : ranges ) {
+        m_boundaries.push_back( min );
+        if( max < std::numeric_limits<int>::max() )
+            m_boundaries.push_back( max + 1 );
+    }
+    std::sort( begin( m_boundaries ), end( m_boundaries ) );
+    m_boundaries.erase( std::unique( begin( m_boundaries ), end( m_boundaries ) ), end( m_boundaries ) );
+    m_intervalMasks.resize( m_boundaries.size() );
+    for( size_t i = 0; i < m_boundaries.size(); i++ ) {
+        for( size_t field = 0; field < fields.size(); field++ ) {
+            if( isInRange( m_boundaries[i], fields[field] ) )
+                m_intervalMasks[i] |= uint64_t( 1 ) << field;
+        }
+    }
 }
 
-bool isTicketValid( const TicketData& ticket, const std::vector<FieldData>& fields )
+uint64_t FieldMaskTable::getMask( int value ) const
 {
-    for( auto& value : ticket.values ) {
-        if( !isValueValid( value, fields ) )
-            return false;
+    if( !m_denseMasks.empty() ) {
+        int64_t offset = int64_t( value ) - m_minValue;
+        return offset >= 0 && offset < int64_t( m_denseMasks.size() ) ? m_denseMasks[size_t( offset )] : 0;
     }
-    return true;
+
+    auto it = std::upper_bound( begin( m_boundaries ), end( m_boundaries ), value );
+    return it == begin( m_boundaries ) ? 0 : m_intervalMasks[it - begin( m_boundaries ) - 1];
 }
 
-void addTicketToValues( const TicketData& ticket, std::map<int, std::set<int>>& values )
+template<typename Func>
+void runOnThreads( size_t numThreads, Func func )
 {
-    for( size_t i = 0; i < ticket.values.size(); i++ )
-        values[i].insert( ticket.values[i] );
+    std::vector<std::thread> threads;
+    for( size_t i = 1; i < numThreads; i++ ) {
+        threads.emplace_back( func, i );
+    }
+    func( 0 );
+    for( auto& thread : threads ) {
+        thread.join();
+    }
 }
 
-std::map<int, std::set<int>> getSetValues( const InputData& inputData )
+struct TicketValidation
+{
+    std::vector<uint8_t> validTickets;
+    int64_t invalidSum = 0;
+};
+
+// One pass over all columns, split by ticket ranges across threads. The validity of each ticket is kept
+// so part 2 does not have to look at invalid tickets again.
+TicketValidation validateTickets( const TicketColumns& tickets, const FieldMaskTable& fieldMasks,
+    size_t numThreads = std::thread::hardware_concurrency() )
 {
-    std::map<int, std::set<int>> values;
+    numThreads = std::clamp<size_t>( numThreads, 1, std::max<size_t>( tickets.numTickets / 4096, 1 ) );
 
-    for( auto& ticket : inputData.nearbyTickets ) {
-        if( !isTicketValid( ticket, inputData.fields ) )
-            continue;
+    TicketValidation validation;
+    validation.validTickets.assign( tickets.numTickets, 1 );
+    std::vector<int64_t> invalidSums( numThreads );
+    runOnThreads( numThreads,
+        [&] ( size_t thread ) {
+            size_t begin = tickets.numTickets * thread / numThreads;
+            size_t end = tickets.numTickets * ( thread + 1 ) / numThreads;
+            int64_t invalidSum = 0;
+            for( size_t column = 0; column < tickets.numColumns; column++ ) {
+                auto values = tickets.column( column );
+                for( size_t ticket = begin; ticket < end; ticket++ ) {
+                    bool valid = fieldMasks.isValid( values[ticket] );
+                    invalidSum += valid ? 0 : values[ticket];
+                    validation.validTickets[ticket] &= valid;
+                }
+            }
+            invalidSums[thread] = invalidSum;
+        } );
 
-        addTicketToValues( ticket, values );
-    }
-    return values;
+    validation.invalidSum = std::accumulate( begin( invalidSums ), end( invalidSums ), int64_t( 0 ) );
+    return validation;
 }
 
-bool valuesValidForField( const std::set<int>& values, const FieldData& field )
+int64_t getSumInvalidData( const InputData& inputData )
 {
-    for( auto& value : values ) {
-        if( !isInRange( value, field ) )
-            return false;
-    }
-    return true;
+    return validateTickets( inputData.nearbyTickets, FieldMaskTable( inputData.fields ) ).invalidSum;
 }
 
-std::vector<std::string> getValidFieldName( const std::set<int>& values, const std::map<std::string, FieldData>& fields )
+std::vector<uint64_t> getColumnCandidates( const InputData& inputData, const FieldMaskTable& fieldMasks, const TicketValidation& validation,
+    size_t numThreads = std::thread::hardware_concurrency() )
 {
-    std::vector<std::string> validFieldNames;
-    for( auto& [name, field] : fields ) {
-        if( valuesValidForField( values, field ) )
-            validFieldNames.push_back( name );
+    auto& tickets = inputData.nearbyTickets;
+    numThreads = std::clamp<size_t>( numThreads, 1, std::max<size_t>( tickets.numTickets / 4096, 1 ) );
+    uint64_t allFields = inputData.fields.size() >= 64 ? ~uint64_t( 0 ) : ( uint64_t( 1 ) << inputData.fields.size() ) - 1;
+
+    std::vector<std::vector<uint64_t>> threadCandidates( numThreads, std::vector<uint64_t>( tickets.numColumns, allFields ) );
+    runOnThreads( numThreads,
+        [&] ( size_t thread ) {
+            size_t begin = tickets.numTickets * thread / numThreads;
+            size_t end = tickets.numTickets * ( thread + 1 ) / numThreads;
+            for( size_t column = 0; column < tickets.numColumns; column++ ) {
+                auto values = tickets.column( column );
+                uint64_t candidates = allFields;
+                for( size_t ticket = begin; ticket < end; ticket++ ) {
+                    candidates &= validation.validTickets[ticket] ? fieldMasks.getMask( values[ticket] ) : allFields;
+                }
+                threadCandidates[thread][column] = candidates;
+            }
+        } );
+
+    std::vector<uint64_t> candidates( tickets.numColumns, allFields );
+    for( auto& partial : threadCandidates ) {
+        for( size_t column = 0; column < tickets.numColumns; column++ ) {
+            candidates[column] &= partial[column];
+        }
     }
-    return validFieldNames;
+    return candidates;
 }
 
-std::vector<std::string> getFieldOrder( const InputData& inputData )
+namespace
 {
-    auto values = getSetValues( inputData );
-    std::map<std::string, FieldData> availableFields;
-    std::transform( begin( inputData.fields ), end( inputData.fields ), std::inserter( availableFields, availableFields.end() ),
-        [] ( const auto& field ) -> std::pair<std::string, FieldData> {
-            return { field.name,field };
-        } );
+    bool findAugmentingPath( size_t column, const std::vector<uint64_t>& candidates, std::vector<int>& columnOfField, uint64_t& visited )
+    {
+        for( uint64_t fields = candidates[column] & ~visited; fields != 0; fields &= fields - 1 ) {
+            int field = std::countr_zero( fields );
+            visited |= uint64_t( 1 ) << field;
+            if( columnOfField[field] < 0 || findAugmentingPath( columnOfField[field], candidates, columnOfField, visited ) ) {
+                columnOfField[field] = int( column );
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::optional<std::vector<int>> getPerfectMatching( const std::vector<uint64_t>& candidates, size_t numFields )
+    {
+        std::vector<int> columnOfField( numFields, -1 );
+        for( size_t column = 0; column < candidates.size(); column++ ) {
+            uint64_t visited = 0;
+            if( !findAugmentingPath( column, candidates, columnOfField, visited ) )
+                return {};
+        }
 
-    std::vector<std::string> fieldNames( values.size() );
-    do {
-        for( auto& [idx, ticketValues] : values ) {
-            auto validFieldNames = getValidFieldName( ticketValues, availableFields );
-            if( validFieldNames.size() == 1 ) {
-                fieldNames[idx] = validFieldNames.front();
-                availableFields.erase( validFieldNames.front() );
+        std::vector<int> fieldOfColumn( candidates.size(), -1 );
+        for( size_t field = 0; field < numFields; field++ ) {
+            if( columnOfField[field] >= 0 )
+                fieldOfColumn[columnOfField[field]] = int( field );
+        }
+        return fieldOfColumn;
+    }
+}
+
+// Resolves columns whose candidate mask has a single field and removes that field everywhere else. If
+// that stalls, a bipartite matching assigns the rest, and the assignment is only accepted when no
+// matched pair can be swapped for another perfect matching.
+std::vector<int> getFieldAssignment( std::vector<uint64_t> candidates, size_t numFields )
+{
+    std::vector<int> fieldOfColumn( candidates.size(), -1 );
+    for( bool progress = true; progress; ) {
+        progress = false;
+        for( size_t column = 0; column < candidates.size(); column++ ) {
+            if( fieldOfColumn[column] >= 0 || std::popcount( candidates[column] ) != 1 )
+                continue;
+            fieldOfColumn[column] = std::countr_zero( candidates[column] );
+            for( size_t other = 0; other < candidates.size(); other++ ) {
+                if( other != column )
+                    candidates[other] &= ~candidates[column];
             }
+            progress = true;
         }
-    } while( !availableFields.empty() );
+    }
+
+    if( std::find( begin( fieldOfColumn ), end( fieldOfColumn ), -1 ) == end( fieldOfColumn ) )
+        return fieldOfColumn;
+
+    auto matching = getPerfectMatching( candidates, numFields );
+    if( !matching )
+        throw std::runtime_error( "no valid field assignment" );
+
+    for( size_t column = 0; column < candidates.size(); column++ ) {
+        if( std::popcount( candidates[column] ) < 2 )
+            continue;
+        auto withoutPair = candidates;
+        withoutPair[column] &= ~( uint64_t( 1 ) << ( *matching )[column] );
+        if( getPerfectMatching( withoutPair, numFields ) )
+            throw std::runtime_error( "ambiguous field assignment" );
+    }
+    return *matching;
+}
 
+std::vector<std::string> getFieldOrder( const InputData& inputData, const FieldMaskTable& fieldMasks, const TicketValidation& validation )
+{
+    auto fieldOfColumn = getFieldAssignment( getColumnCandidates( inputData, fieldMasks, validation ), inputData.fields.size() );
+
+    std::vector<std::string> fieldNames;
+    std::transform( begin( fieldOfColumn ), end( fieldOfColumn ), std::back_inserter( fieldNames ),
+        [&inputData] ( int field ) { return inputData.fields[field].name; } );
     return fieldNames;
 }
 
-int64_t getDepartureProduct( const InputData& inputData )
+int64_t getDepartureProduct( const InputData& inputData, const FieldMaskTable& fieldMasks, const TicketValidation& validation )
 {
-    auto fieldOrder = getFieldOrder( inputData );
+    auto fieldOrder = getFieldOrder( inputData, fieldMasks, validation );
 
     int64_t sum = 1;
     for( size_t i = 0; i < fieldOrder.size(); i++ ) 		{
@@ -173,12 +397,20 @@ int64_t getDepartureProduct( const InputData& inputData )
     return sum;
 }
 
+int64_t getDepartureProduct( const InputData& inputData )
+{
+    FieldMaskTable fieldMasks( inputData.fields );
+    return getDepartureProduct( inputData, fieldMasks, validateTickets( inputData.nearbyTickets, fieldMasks ) );
+}
+
 void Day16()
 {
     auto inputData = getInputData( "Day16Input.txt" );
+    FieldMaskTable fieldMasks( inputData.fields );
+    auto validation = validateTickets( inputData.nearbyTickets, fieldMasks );
 
     std::cout << "Day16:\n";
-    std::cout << "Part1: Get sum invalid data: " << getSumInvalidData( inputData ) << "\n";
-    std::cout << "Part2: Get sum with departure: " << getDepartureProduct( inputData ) << "\n";
+    std::cout << "Part1: Get sum invalid data: " << validation.invalidSum << "\n";
+    std::cout << "Part2: Get sum with departure: " << getDepartureProduct( inputData, fieldMasks, validation ) << "\n";
 }
 
@@ -13,6 +13,13 @@
 #include <list>
 #include <array>
 #include <span>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <bit>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
 
 template<uint8_t numDims>
 class ConwaysCube
@@ -37,8 +44,110 @@ private:
     std::array<int64_t, numDims> m_sizes;
 };
 
+// Open addressing table from packed cell to neighbor count, plus a flag for cells that are active
+// in the current generation. clear() keeps the capacity for the next generation.
+template<typename CountType>
+class CellTable
+{
+public:
+    static constexpr uint64_t emptyCell = std::numeric_limits<uint64_t>::max();
+
+    struct Slot
+    {
+        uint64_t cell = emptyCell;
+        CountType count = 0;
+        bool active = false;
+    };
+
+    void clear( size_t expectedNumCells );
+    void setActive( uint64_t cell ) { getSlot( cell ).active = true; }
+    void add( uint64_t cell, CountType amount ) { getSlot( cell ).count += amount; }
+
+    template<typename Func>
+    void forEach( Func func ) const;
+
+private:
+    size_t getSlotIdx( uint64_t cell ) const { return size_t( ( cell * 0x9E3779B97F4A7C15ull ) >> m_shift ); }
+    Slot& getSlot( uint64_t cell );
+    void resize( size_t capacity );
+
+    std::vector<Slot> m_slots;
+    int m_shift = 64;
+    size_t m_size = 0;
+};
+
+// Only the active cells are stored, each as one packed uint64 with bitsPerDim bits per coordinate.
+// Coordinates are biased so that a neighbor is reached by adding a precomputed packed offset, and a
+// generation costs the number of active cells times the number of neighbors, independent of the extent.
+template<uint8_t numDims>
+class SparseCube
+{
+public:
+    SparseCube( std::string path );
+    void iterate();
+    void iterate( int64_t num );
+    int64_t getNumSet() const { return int64_t( m_active.size() ); }
+
+private:
+    static constexpr int bitsPerDim = std::min( 64 / int( numDims ), 16 );
+    static constexpr int64_t bias = int64_t( 1 ) << ( bitsPerDim - 1 );
+
+    static uint64_t pack( const std::array<int64_t, numDims>& pos );
+
+    std::vector<uint64_t> m_active;
+    std::vector<uint64_t> m_neighborOffsets;
+    CellTable<uint16_t> m_cells;
+    int64_t m_extent = 0;
+};
+
+// The start slice is flat in every dimension past x and y, so the state stays symmetric under mirroring
+// and permuting those dimensions. Only the canonical region 0 <= z <= w <= ... is stored, as one dense
+// x/y plane per canonical tuple of extra coordinates. A plane's neighbor counts are the 3x3 box sums of
+// the planes its extra neighbors map onto, weighted by how many of the 3^n extra offsets map there.
 template<uint8_t numDims>
-inline int64_t getNumActiveCubes( ConwaysCube<numDims>& cube, int64_t iter )
+class SymmetricCube
+{
+public:
+    SymmetricCube( std::string path );
+    void iterate();
+    void iterate( int64_t num );
+    int64_t getNumSet() const;
+    int64_t getNumStored() const;
+
+private:
+    static constexpr int numExtraDims = numDims - 2;
+    static constexpr int bitsPerExtra = std::min( 64 / numExtraDims, 16 );
+    static constexpr uint64_t fieldMask = ( uint64_t( 1 ) << bitsPerExtra ) - 1;
+
+    using Extras = std::array<int64_t, numExtraDims>;
+
+    struct NeighborExtras
+    {
+        uint64_t extras;
+        uint32_t multiplicity;
+    };
+
+    struct BoxSums
+    {
+        std::vector<uint8_t> sums;
+        int rowBegin, rowEnd, colBegin, colEnd;
+    };
+
+    static uint64_t packExtras( const Extras& extras );
+    static Extras unpackExtras( uint64_t packedExtras );
+    static uint32_t getOrbitSize( const Extras& extras );
+
+    const std::vector<NeighborExtras>& getNeighborExtras( uint64_t extras );
+    BoxSums getBoxSums( const std::vector<uint8_t>& plane ) const;
+
+    std::unordered_map<uint64_t, std::vector<uint8_t>> m_planes;
+    std::unordered_map<uint64_t, std::vector<NeighborExtras>> m_neighborExtras;
+    int m_side = 0;
+    int64_t m_generation = 0;
+};
+
+template<typename CubeType>
+inline int64_t getNumActiveCubes( CubeType& cube, int64_t iter )
 {
     cube.iterate( iter );
     return cube.getNumSet();
@@ -46,8 +155,8 @@ inline int64_t getNumActiveCubes( ConwaysCube<numDims>& cube, int64_t iter )
 
 inline void Day17()
 {
-    ConwaysCube<3> cube( "Day17Input.txt" );
-    ConwaysCube<4> hyperCube( "Day17Input.txt" );
+    SymmetricCube<3> cube( "Day17Input.txt" );
+    SymmetricCube<4> hyperCube( "Day17Input.txt" );
 
     std::cout << "Day 17:\n";
     std::cout << "Part1: Number of cubes in cube after 6 iterations: " << getNumActiveCubes( cube, 6 ) << "\n";
@@ -281,3 +390,350 @@ int ConwaysCube<numDims>::getNumNeighbors( const std::array<int64_t, numDims>& p
 
     return numNeighbors;
 }
+
+template<typename CountType>
+void CellTable<CountType>::clear( size_t expectedNumCells )
+{
+    size_t capacity = std::bit_ceil( std::max<size_t>( expectedNumCells * 2, 16 ) );
+    if( capacity > m_slots.size() ) {
+        m_slots.assign( capacity, {} );
+        m_shift = 64 - std::countr_zero( capacity );
+    }
+    else {
+        std::fill( begin( m_slots ), end( m_slots ), Slot{} );
+    }
+    m_size = 0;
+}
+
+template<typename CountType>
+void CellTable<CountType>::resize( size_t capacity )
+{
+    auto oldSlots = std::move( m_slots );
+    m_slots.assign( capacity, {} );
+    m_shift = 64 - std::countr_zero( capacity );
+    m_size = 0;
+    for( auto& oldSlot : oldSlots ) {
+        if( oldSlot.cell != emptyCell )
+            getSlot( oldSlot.cell ) = oldSlot;
+    }
+}
+
+template<typename CountType>
+typename CellTable<CountType>::Slot& CellTable<CountType>::getSlot( uint64_t cell )
+{
+    size_t mask = m_slots.size() - 1;
+    for( size_t idx = getSlotIdx( cell );; idx = ( idx + 1 ) & mask ) {
+        auto& slot = m_slots[idx];
+        if( slot.cell == cell )
+            return slot;
+        if( slot.cell == emptyCell ) {
+            if( ( m_size + 1 ) * 2 > m_slots.size() ) {
+                resize( m_slots.size() * 2 );
+                return getSlot( cell );
+            }
+            m_size++;
+            slot.cell = cell;
+            return slot;
+        }
+    }
+}
+
+template<typename CountType>
+template<typename Func>
+void CellTable<CountType>::forEach( Func func ) const
+{
+    for( auto& slot : m_slots ) {
+        if( slot.cell != emptyCell )
+            func( slot );
+    }
+}
+
+template<uint8_t numDims>
+uint64_t SparseCube<numDims>::pack( const std::array<int64_t, numDims>& pos )
+{
+    uint64_t cell = 0;
+    for( size_t i = 0; i < numDims; i++ ) {
+        cell |= uint64_t( pos[i] + bias ) << ( i * bitsPerDim );
+    }
+    return cell;
+}
+
+template<uint8_t numDims>
+SparseCube<numDims>::SparseCube( std::string path )
+{
+    static_assert( numDims > 2 );
+
+    std::ifstream file( path );
+    int64_t y = 0;
+    for( std::string line; std::getline( file, line ); y++ ) {
+        for( int64_t x = 0; x < int64_t( line.size() ); x++ ) {
+            if( line[x] != '#' )
+                continue;
+            std::array<int64_t, numDims> pos{ x, y };
+            m_active.push_back( pack( pos ) );
+        }
+        m_extent = std::max<int64_t>( { m_extent, y + 1, int64_t( line.size() ) } );
+    }
+
+    // Adding the packed offset carries correctly between fields as long as every biased coordinate
+    // stays inside its field, which iterate() checks through m_extent.
+    std::array<int64_t, numDims> offset;
+    offset.fill( -1 );
+    while( true ) {
+        if( std::any_of( begin( offset ), end( offset ), [] ( int64_t o ) { return o != 0; } ) ) {
+            uint64_t packedOffset = 0;
+            for( size_t i = 0; i < numDims; i++ ) {
+                packedOffset += uint64_t( offset[i] ) << ( i * bitsPerDim );
+            }
+            m_neighborOffsets.push_back( packedOffset );
+        }
+        size_t i = 0;
+        for( ; i < numDims && offset[i] == 1; i++ ) {
+            offset[i] = -1;
+        }
+        if( i == numDims )
+            break;
+        offset[i]++;
+    }
+}
+
+template<uint8_t numDims>
+void SparseCube<numDims>::iterate()
+{
+    if( ++m_extent >= bias - 1 )
+        throw std::runtime_error( "cube grew beyond the packed coordinate range" );
+
+    m_cells.clear( m_active.size() * std::min<size_t>( m_neighborOffsets.size(), 32 ) );
+    for( uint64_t cell : m_active ) {
+        m_cells.setActive( cell );
+        for( uint64_t offset : m_neighborOffsets ) {
+            m_cells.add( cell + offset, 1 );
+        }
+    }
+
+    m_active.clear();
+    m_cells.forEach(
+        [this] ( const auto& slot ) {
+            if( slot.count == 3 || slot.active && slot.count == 2 )
+                m_active.push_back( slot.cell );
+        } );
+}
+
+template<uint8_t numDims>
+void SparseCube<numDims>::iterate( int64_t num )
+{
+    for( int64_t i = 0; i < num; i++ ) {
+        iterate();
+    }
+}
+
+template<uint8_t numDims>
+uint64_t SymmetricCube<numDims>::packExtras( const Extras& extras )
+{
+    uint64_t packed = 0;
+    for( size_t i = 0; i < numExtraDims; i++ ) {
+        packed |= uint64_t( extras[i] ) << ( i * bitsPerExtra );
+    }
+    return packed;
+}
+
+template<uint8_t numDims>
+typename SymmetricCube<numDims>::Extras SymmetricCube<numDims>::unpackExtras( uint64_t packedExtras )
+{
+    Extras extras;
+    for( size_t i = 0; i < numExtraDims; i++ ) {
+        extras[i] = int64_t( ( packedExtras >> ( i * bitsPerExtra ) ) & fieldMask );
+    }
+    return extras;
+}
+
+// Number of cells in the full space that map onto these sorted, non negative extra coordinates:
+// the distinct permutations times a factor 2 for every coordinate that can be mirrored.
+template<uint8_t numDims>
+uint32_t SymmetricCube<numDims>::getOrbitSize( const Extras& extras )
+{
+    uint32_t size = 1;
+    int runLength = 0;
+    for( size_t i = 0; i < numExtraDims; i++ ) {
+        runLength = ( i > 0 && extras[i] == extras[i - 1] ) ? runLength + 1 : 1;
+        size = size * uint32_t( i + 1 ) / runLength;
+        size *= extras[i] != 0 ? 2 : 1;
+    }
+    return size;
+}
+
+// The canonical extra coordinates reached from these extra coordinates, each with the number of the 3^n
+// offsets leading to it. The own extra coordinates come first. The lists only depend on the extra
+// coordinates, so they are cached across generations.
+template<uint8_t numDims>
+const std::vector<typename SymmetricCube<numDims>::NeighborExtras>& SymmetricCube<numDims>::getNeighborExtras( uint64_t packedExtras )
+{
+    auto [it, isNew] = m_neighborExtras.try_emplace( packedExtras );
+    auto& neighbors = it->second;
+    if( !isNew )
+        return neighbors;
+
+    auto extras = unpackExtras( packedExtras );
+    neighbors.push_back( { packedExtras, 0 } );
+    std::array<int64_t, numExtraDims> offset;
+    offset.fill( -1 );
+    while( true ) {
+        Extras neighbor;
+        for( size_t i = 0; i < numExtraDims; i++ ) {
+            neighbor[i] = std::abs( extras[i] + offset[i] );
+        }
+        std::sort( begin( neighbor ), end( neighbor ) );
+        uint64_t packed = packExtras( neighbor );
+        auto found = std::find_if( begin( neighbors ), end( neighbors ), [packed] ( const NeighborExtras& n ) { return n.extras == packed; } );
+        if( found == end( neighbors ) )
+            neighbors.push_back( { packed, 1 } );
+        else
+            found->multiplicity++;
+
+        size_t i = 0;
+        for( ; i < numExtraDims && offset[i] == 1; i++ ) {
+            offset[i] = -1;
+        }
+        if( i == numExtraDims )
+            break;
+        offset[i]++;
+    }
+    return neighbors;
+}
+
+template<uint8_t numDims>
+SymmetricCube<numDims>::SymmetricCube( std::string path )
+{
+    static_assert( numDims > 2 );
+
+    std::ifstream file( path );
+    std::vector<std::string> lines;
+    for( std::string line; std::getline( file, line ); ) {
+        lines.push_back( line );
+        m_side = std::max<int>( { m_side, int( lines.size() ), int( line.size() ) } );
+    }
+
+    std::vector<uint8_t> plane( size_t( m_side ) * m_side );
+    for( size_t y = 0; y < lines.size(); y++ ) {
+        for( size_t x = 0; x < lines[y].size(); x++ ) {
+            plane[y * m_side + x] = lines[y][x] == '#';
+        }
+    }
+    if( std::find( begin( plane ), end( plane ), 1 ) != end( plane ) )
+        m_planes.emplace( packExtras( {} ), std::move( plane ) );
+}
+
+// 3x3 box sums of a plane in the coordinates of the next generation, which are shifted by one.
+// Only the bounding box of the active cells plus a border of one is filled.
+template<uint8_t numDims>
+typename SymmetricCube<numDims>::BoxSums SymmetricCube<numDims>::getBoxSums( const std::vector<uint8_t>& plane ) const
+{
+    int newSide = m_side + 2;
+    BoxSums box{ std::vector<uint8_t>( size_t( newSide ) * newSide ), newSide, 0, newSide, 0 };
+    for( int row = 0; row < m_side; row++ ) {
+        for( int col = 0; col < m_side; col++ ) {
+            if( !plane[size_t( row ) * m_side + col] )
+                continue;
+            box.rowBegin = std::min( box.rowBegin, row );
+            box.rowEnd = std::max( box.rowEnd, row + 3 );
+            box.colBegin = std::min( box.colBegin, col );
+            box.colEnd = std::max( box.colEnd, col + 3 );
+            for( int dRow = 0; dRow < 3; dRow++ ) {
+                for( int dCol = 0; dCol < 3; dCol++ ) {
+                    box.sums[size_t( row + dRow ) * newSide + col + dCol]++;
+                }
+            }
+        }
+    }
+    return box;
+}
+
+template<uint8_t numDims>
+void SymmetricCube<numDims>::iterate()
+{
+    if( ++m_generation > int64_t( fieldMask ) )
+        throw std::runtime_error( "cube grew beyond the packed coordinate range" );
+
+    std::unordered_map<uint64_t, BoxSums> boxSums;
+    std::vector<uint64_t> targets;
+    for( auto& [extras, plane] : m_planes ) {
+        boxSums.emplace( extras, getBoxSums( plane ) );
+        for( auto& neighbor : getNeighborExtras( extras ) ) {
+            targets.push_back( neighbor.extras );
+        }
+    }
+    std::sort( begin( targets ), end( targets ) );
+    targets.erase( std::unique( begin( targets ), end( targets ) ), end( targets ) );
+
+    int newSide = m_side + 2;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> newPlanes;
+    std::vector<uint16_t> counts( size_t( newSide ) * newSide );
+    for( uint64_t target : targets ) {
+        int rowBegin = newSide, rowEnd = 0, colBegin = newSide, colEnd = 0;
+        for( auto& neighbor : getNeighborExtras( target ) ) {
+            auto it = boxSums.find( neighbor.extras );
+            if( it == end( boxSums ) )
+                continue;
+            auto& box = it->second;
+            for( int row = box.rowBegin; row < box.rowEnd; row++ ) {
+                size_t rowStart = size_t( row ) * newSide;
+                for( int col = box.colBegin; col < box.colEnd; col++ ) {
+                    counts[rowStart + col] += uint16_t( neighbor.multiplicity * box.sums[rowStart + col] );
+                }
+            }
+            rowBegin = std::min( rowBegin, box.rowBegin );
+            rowEnd = std::max( rowEnd, box.rowEnd );
+            colBegin = std::min( colBegin, box.colBegin );
+            colEnd = std::max( colEnd, box.colEnd );
+        }
+
+        // The box sums include the cell itself, which is no neighbor
+        auto oldPlane = m_planes.find( target );
+        std::vector<uint8_t> plane( size_t( newSide ) * newSide );
+        bool anyActive = false;
+        for( int row = rowBegin; row < rowEnd; row++ ) {
+            for( int col = colBegin; col < colEnd; col++ ) {
+                size_t idx = size_t( row ) * newSide + col;
+                bool active = oldPlane != end( m_planes ) && row > 0 && row <= m_side && col > 0 && col <= m_side
+                    && oldPlane->second[size_t( row - 1 ) * m_side + col - 1];
+                int numNeighbors = counts[idx] - active;
+                plane[idx] = numNeighbors == 3 || active && numNeighbors == 2;
+                anyActive |= plane[idx] != 0;
+                counts[idx] = 0;
+            }
+        }
+        if( anyActive )
+            newPlanes.emplace( target, std::move( plane ) );
+    }
+
+    m_planes = std::move( newPlanes );
+    m_side = newSide;
+}
+
+template<uint8_t numDims>
+void SymmetricCube<numDims>::iterate( int64_t num )
+{
+    for( int64_t i = 0; i < num; i++ ) {
+        iterate();
+    }
+}
+
+template<uint8_t numDims>
+int64_t SymmetricCube<numDims>::getNumSet() const
+{
+    int64_t numSet = 0;
+    for( auto& [extras, plane] : m_planes ) {
+        numSet += int64_t( getOrbitSize( unpackExtras( extras ) ) ) * std::count( begin( plane ), end( plane ), 1 );
+    }
+    return numSet;
+}
+
+template<uint8_t numDims>
+int64_t SymmetricCube<numDims>::getNumStored() const
+{
+    int64_t numStored = 0;
+    for( auto& [extras, plane] : m_planes ) {
+        numStored += std::count( begin( plane ), end( plane ), 1 );
+    }
+    return numStored;
+}
@@ -6,35 +6,32 @@
 #include <fstream>
 #include <iostream>
 
+#include "Grid.h"
 
-struct TreeMap
-{
-    int sizeX = 0;
-    int sizeY = 0;
-    std::vector<std::string> data;
-};
+using TreeMap = Grid<char>;
 
 TreeMap readTreeMap( std::string_view path )
 {
-    TreeMap treemap;
+    std::vector<char> data;
+    int numCols = 0;
+    int numRows = 0;
     std::ifstream file( path.data() );
-    for( std::string line; std::getline( file, line ); ) {
-        treemap.data.push_back( line );
-        treemap.sizeY++;
+    for( std::string line; std::getline( file, line ); numRows++ ) {
+        numCols = int( line.size() );
+        data.insert( data.end(), begin( line ), end( line ) );
     }
-    treemap.sizeX = treemap.data[0].size();
-    return treemap;
+    return { numCols, numRows, data };
 }
 
 bool checkTreemap( int x, int y, const TreeMap& treeMap )
 {
-    return treeMap.data[y][x % treeMap.sizeX] == '#';
+    return treeMap.at( x % treeMap.getNumCols(), y ) == '#';
 }
 
 int traverseTreemap( int dirX, int dirY, const TreeMap& treeMap )
 {
     int numTrees = 0;
-    for( int y = 0, x = 0; y < treeMap.sizeY; y+=dirY,x+=dirX ) {
+    for( int y = 0, x = 0; y < treeMap.getNumRows(); y+=dirY,x+=dirX ) {
         numTrees += checkTreemap( x, y, treeMap );
     }
     return numTrees;
@@ -11,6 +11,10 @@
 #include <map>
 #include <deque>
 #include <span>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 
 std::vector<size_t> getData( const std::string& path )
 {
@@ -59,6 +63,80 @@ int firstNotSumOfPrevious( const std::vector<size_t>& data, size_t numPrevious )
     return std::numeric_limits<int>::min();
 }
 
+std::vector<size_t> getInvalidIndices( const std::vector<size_t>& data, size_t numPrevious, size_t begin, size_t end, bool stopAtFirst )
+{
+    std::vector<size_t> invalidIndices;
+    std::deque<std::pair<size_t, std::set<size_t>>> previousSums;
+    for( size_t i = begin - numPrevious; i < begin; i++ ) {
+        updatePreviousSums( data[i], previousSums, numPrevious );
+    }
+
+    for( size_t i = begin; i < end; i++ ) {
+        if( !isSumOfPrevious( data[i], previousSums ) ) {
+            invalidIndices.push_back( i );
+            if( stopAtFirst )
+                break;
+        }
+        updatePreviousSums( data[i], previousSums, numPrevious );
+    }
+    return invalidIndices;
+}
+
+enum class ScanMode
+{
+    FirstInvalid,
+    AllInvalid
+};
+
+// Checks chunks of [numPrevious, data.size()) on a pool of worker threads. Every chunk re-reads the
+// numPrevious values in front of it, so each one can be validated independently of the others.
+std::vector<size_t> getInvalidIndicesParallel( const std::vector<size_t>& data, size_t numPrevious, ScanMode mode,
+    size_t chunkSize = 1 << 16, size_t numThreads = std::thread::hardware_concurrency() )
+{
+    if( data.size() <= numPrevious )
+        return {};
+
+    chunkSize = std::max<size_t>( chunkSize, 1 );
+    numThreads = std::max<size_t>( numThreads, 1 );
+    size_t numChunks = ( data.size() - numPrevious + chunkSize - 1 ) / chunkSize;
+    std::vector<std::vector<size_t>> chunkResults( numChunks );
+    std::atomic<size_t> nextChunk = 0;
+    std::atomic<size_t> firstInvalidChunk = numChunks;
+
+    auto worker = [&] () {
+        for( size_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++ ) {
+            if( mode == ScanMode::FirstInvalid && chunk > firstInvalidChunk )
+                break;
+
+            size_t begin = numPrevious + chunk * chunkSize;
+            size_t end = std::min( begin + chunkSize, data.size() );
+            chunkResults[chunk] = getInvalidIndices( data, numPrevious, begin, end, mode == ScanMode::FirstInvalid );
+
+            if( mode == ScanMode::FirstInvalid && !chunkResults[chunk].empty() ) {
+                size_t expected = firstInvalidChunk;
+                while( chunk < expected && !firstInvalidChunk.compare_exchange_weak( expected, chunk ) );
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for( size_t i = 1; i < std::min( numThreads, numChunks ); i++ ) {
+        threads.emplace_back( worker );
+    }
+    worker();
+    for( auto& thread : threads ) {
+        thread.join();
+    }
+
+    std::vector<size_t> invalidIndices;
+    for( auto& chunkResult : chunkResults ) {
+        invalidIndices.insert( invalidIndices.end(), begin( chunkResult ), end( chunkResult ) );
+        if( mode == ScanMode::FirstInvalid && !invalidIndices.empty() )
+            break;
+    }
+    return invalidIndices;
+}
+
 std::optional<size_t> sumOfContigiousLimit( std::span<size_t> data, size_t value )
 {
     if( data.empty() )
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <vector>
+#include <iostream>
+#include <optional>
+#include <cstdint>
+#include <algorithm>
+
+enum class GridLayout
+{
+    RowMajor,
+    Tiled,
+    Morton
+};
+
+namespace grid_detail
+{
+    constexpr int tileSize = 8;
+
+    inline uint64_t spreadBits( uint32_t value )
+    {
+        uint64_t x = value;
+        x = ( x | ( x << 16 ) ) & 0x0000FFFF0000FFFFull;
+        x = ( x | ( x << 8 ) ) & 0x00FF00FF00FF00FFull;
+        x = ( x | ( x << 4 ) ) & 0x0F0F0F0F0F0F0F0Full;
+        x = ( x | ( x << 2 ) ) & 0x3333333333333333ull;
+        x = ( x | ( x << 1 ) ) & 0x5555555555555555ull;
+        return x;
+    }
+
+    inline int roundUp( int value, int multiple )
+    {
+        return ( value + multiple - 1 ) / multiple * multiple;
+    }
+
+    inline int nextPowerOfTwo( int value )
+    {
+        int power = 1;
+        while( power < value )
+            power *= 2;
+        return power;
+    }
+}
+
+template<typename GridType, bool isRow>
+class GridLine
+{
+public:
+    GridLine( GridType& grid, int idx ) : m_grid( grid ), m_idx( idx ) {}
+    decltype( auto ) operator[]( int pos ) const { return isRow ? m_grid.at( pos, m_idx ) : m_grid.at( m_idx, pos ); }
+    int size() const { return isRow ? m_grid.getNumCols() : m_grid.getNumRows(); }
+
+    class Iterator
+    {
+    public:
+        Iterator( const GridLine& line, int pos ) : m_line( line ), m_pos( pos ) {}
+        decltype( auto ) operator*() const { return m_line[m_pos]; }
+        Iterator& operator++() { ++m_pos; return *this; }
+        bool operator!=( const Iterator& other ) const { return m_pos != other.m_pos; }
+
+    private:
+        const GridLine& m_line;
+        int m_pos;
+    };
+
+    Iterator begin() const { return { *this, 0 }; }
+    Iterator end() const { return { *this, size() }; }
+
+private:
+    GridType& m_grid;
+    int m_idx;
+};
+
+// 2D grid with a one cell border filled with a sentinel value, so at() can be used on every neighbor
+// of an inside cell without a bounds check. The layout only changes how cells are ordered in memory.
+template<typename T, GridLayout layout = GridLayout::RowMajor>
+class Grid
+{
+public:
+    using RowView = GridLine<Grid, true>;
+    using ConstRowView = GridLine<const Grid, true>;
+    using ColumnView = GridLine<Grid, false>;
+    using ConstColumnView = GridLine<const Grid, false>;
+
+    Grid( int numCols, int numRows, T border = T{} );
+    Grid( int numCols, int numRows, const std::vector<T>& data, T border = T{} );
+
+    T& at( int col, int row ) { return m_data[getIdx( col, row )]; }
+    const T& at( int col, int row ) const { return m_data[getIdx( col, row )]; }
+    std::optional<T> optAt( int col, int row ) const { if( !isInside( col, row ) ) return {}; return at( col, row ); }
+    bool isInside( int col, int row ) const { return col >= 0 && col < m_numCols && row >= 0 && row < m_numRows; }
+    int getNumRows() const { return m_numRows; }
+    int getNumCols() const { return m_numCols; }
+
+    RowView row( int row ) { return { *this, row }; }
+    ConstRowView row( int row ) const { return { *this, row }; }
+    ColumnView column( int col ) { return { *this, col }; }
+    ConstColumnView column( int col ) const { return { *this, col }; }
+
+    void print() const;
+
+private:
+    size_t getIdx( int col, int row ) const;
+
+    std::vector<T> m_data;
+    int m_numCols;
+    int m_numRows;
+    int m_paddedCols;
+    int m_paddedRows;
+};
+
+template<typename T, GridLayout layout>
+Grid<T, layout>::Grid( int numCols, int numRows, T border )
+    : m_numCols( numCols ), m_numRows( numRows ), m_paddedCols( numCols + 2 ), m_paddedRows( numRows + 2 )
+{
+    if constexpr( layout == GridLayout::Tiled ) {
+        m_paddedCols = grid_detail::roundUp( m_paddedCols, grid_detail::tileSize );
+        m_paddedRows = grid_detail::roundUp( m_paddedRows, grid_detail::tileSize );
+    }
+    else if constexpr( layout == GridLayout::Morton ) {
+        m_paddedCols = m_paddedRows = grid_detail::nextPowerOfTwo( std::max( m_paddedCols, m_paddedRows ) );
+    }
+    m_data.resize( size_t( m_paddedCols ) * m_paddedRows, border );
+}
+
+template<typename T, GridLayout layout>
+Grid<T, layout>::Grid( int numCols, int numRows, const std::vector<T>& data, T border )
+    : Grid( numCols, numRows, border )
+{
+    for( int row = 0; row < m_numRows; row++ ) {
+        for( int col = 0; col < m_numCols; col++ ) {
+            at( col, row ) = data[col + size_t( row ) * m_numCols];
+        }
+    }
+}
+
+template<typename T, GridLayout layout>
+size_t Grid<T, layout>::getIdx( int col, int row ) const
+{
+    size_t x = col + 1;
+    size_t y = row + 1;
+    if constexpr( layout == GridLayout::RowMajor ) {
+        return x + y * m_paddedCols;
+    }
+    else if constexpr( layout == GridLayout::Tiled ) {
+        constexpr size_t tileSize = grid_detail::tileSize;
+        size_t tile = x / tileSize + y / tileSize * ( m_paddedCols / tileSize );
+        return tile * tileSize * tileSize + x % tileSize + y % tileSize * tileSize;
+    }
+    else {
+        return grid_detail::spreadBits( uint32_t( x ) ) | ( grid_detail::spreadBits( uint32_t( y ) ) << 1 );
+    }
+}
+
+template<typename T, GridLayout layout>
+void Grid<T, layout>::print() const
+{
+    for( int row = 0; row < m_numRows; row++ ) {
+        for( int col = 0; col < m_numCols; col++ ) {
+            std::cout << at( col, row );
+        }
+        std::cout << "\n";
+    }
+}
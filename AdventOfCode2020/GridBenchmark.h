@@ -0,0 +1,51 @@
+#pragma once
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+
+#include "Grid.h"
+
+template<GridLayout layout>
+int64_t sumNeighborCounts( const Grid<uint8_t, layout>& grid )
+{
+    int64_t sum = 0;
+    for( int row = 0; row < grid.getNumRows(); row++ ) {
+        for( int col = 0; col < grid.getNumCols(); col++ ) {
+            sum += grid.at( col - 1, row - 1 ) + grid.at( col, row - 1 ) + grid.at( col + 1, row - 1 )
+                + grid.at( col - 1, row ) + grid.at( col + 1, row )
+                + grid.at( col - 1, row + 1 ) + grid.at( col, row + 1 ) + grid.at( col + 1, row + 1 );
+        }
+    }
+    return sum;
+}
+
+template<GridLayout layout>
+void benchmarkLayout( const std::string& name, int size, const std::vector<uint8_t>& data, int numRuns )
+{
+    Grid<uint8_t, layout> grid( size, size, data );
+
+    int64_t result = 0;
+    auto start = std::chrono::steady_clock::now();
+    for( int i = 0; i < numRuns; i++ ) {
+        result += sumNeighborCounts( grid );
+    }
+    auto duration = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start );
+
+    std::cout << name << ": " << duration.count() / numRuns << " ms per pass (checksum " << result << ")\n";
+}
+
+void GridBenchmark( int size = 4096, int numRuns = 5 )
+{
+    std::mt19937 rng( 42 );
+    std::vector<uint8_t> data( size_t( size ) * size );
+    for( auto& cell : data ) {
+        cell = rng() % 2;
+    }
+
+    std::cout << "Grid neighbor count " << size << "x" << size << ":\n";
+    benchmarkLayout<GridLayout::RowMajor>( "RowMajor", size, data, numRuns );
+    benchmarkLayout<GridLayout::Tiled>( "Tiled", size, data, numRuns );
+    benchmarkLayout<GridLayout::Morton>( "Morton", size, data, numRuns );
+}